@@ -533,6 +533,7 @@ static int examine_vfolders (MUTTMENU *menu, struct browser_state *state)
     }
   }
   while ((tmp = tmp->next));
+  nm_nonctx_release_db();
   browser_sort (state);
   return 0;
 }
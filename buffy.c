@@ -39,6 +39,10 @@
 #include "mutt_notmuch.h"
 #endif
 
+#ifdef USE_INOTIFY
+#include "monitor.h"
+#endif
+
 #include <string.h>
 #include <sys/stat.h>
 #include <dirent.h>
@@ -52,6 +56,10 @@ static time_t BuffyTime = 0;	/* last time we started checking for mail */
 time_t BuffyDoneTime = 0;	/* last time we knew for sure how much mail there was. */
 static short BuffyCount = 0;	/* how many boxes with new mail */
 static short BuffyNotify = 0;	/* # of unnotified new boxes */
+#ifdef USE_INOTIFY
+static short LastCheckRecent = -1;	/* $mail_check_recent at the last check */
+static short LastCheckMboxSize = -1;	/* $check_mbox_size at the last check */
+#endif
 
 static BUFFY* buffy_get (const char *path);
 
@@ -224,7 +232,15 @@ static BUFFY *buffy_new (const char *path)
 static void buffy_free (BUFFY **mailbox)
 {
   if (mailbox && *mailbox)
+  {
+#ifdef USE_INOTIFY
+    mutt_monitor_remove (*mailbox);
+#endif
+#ifdef USE_SIDEBAR
+    FREE (&(*mailbox)->sb_entry.str);
+#endif
     FREE (&(*mailbox)->desc);
+  }
   FREE (mailbox); /* __FREE_CHECKED__ */
 }
 
@@ -454,50 +470,71 @@ static int buffy_maildir_hasnew (BUFFY* mailbox)
  * buffy_maildir_update_dir - Update counts for one directory
  * @mailbox: BUFFY representing a maildir mailbox
  * @dir:     Which directory to search
+ * @dc:      Counts of the directory from the last time
  *
  * Look through one directory of a maildir mailbox.  The directory could
  * be either "new" or "cur".
  *
- * Count how many new, or flagged, messages there are.
+ * Count how many new, or flagged, messages there are.  The directory is
+ * only read again if it has been modified since it was counted last;
+ * otherwise the remembered counts are used.
  */
 static void
-buffy_maildir_update_dir (BUFFY *mailbox, const char *dir)
+buffy_maildir_update_dir (BUFFY *mailbox, const char *dir,
+			  struct buffy_dircount *dc)
 {
 	char path[_POSIX_PATH_MAX] = "";
 	DIR *dirp = NULL;
 	struct dirent *de = NULL;
+	struct stat st;
 	char *p = NULL;
 	int read;
 
 	snprintf (path, sizeof (path), "%s/%s", mailbox->path, dir);
 
-	dirp = opendir (path);
+	if (stat (path, &st) == 0) {
+		/* a change within the second it was counted in could have been missed */
+		if (dc->counted > st.st_mtime &&
+		    dc->mtime == st.st_mtime && dc->ino == st.st_ino)
+			goto done;
+		dirp = opendir (path);
+	}
 	if (!dirp) {
+		memset (dc, 0, sizeof (*dc));
 		mailbox->magic = 0;
 		return;
 	}
 
+	dc->mtime = st.st_mtime;
+	dc->ino = st.st_ino;
+	dc->counted = time (NULL);
+	dc->msg_count = dc->msg_unread = dc->msg_flagged = 0;
+
 	while ((de = readdir (dirp)) != NULL) {
 		if (*de->d_name == '.')
 			continue;
 
 		/* Matches maildir_parse_flags logic */
 		read = 0;
-		mailbox->msg_count++;
+		dc->msg_count++;
 		p = strstr (de->d_name, ":2,");
 		if (p) {
 			p += 3;
 			if (strchr (p, 'S'))
 				read = 1;
 			if (strchr (p, 'F'))
-				mailbox->msg_flagged++;
+				dc->msg_flagged++;
 		}
 		if (!read) {
-			mailbox->msg_unread++;
+			dc->msg_unread++;
 		}
 	}
 
 	closedir (dirp);
+done:
+	mailbox->msg_count   += dc->msg_count;
+	mailbox->msg_unread  += dc->msg_unread;
+	mailbox->msg_flagged += dc->msg_flagged;
 }
 
 /**
@@ -517,16 +554,13 @@ buffy_maildir_update (BUFFY *mailbox)
 	mailbox->msg_unread  = 0;
 	mailbox->msg_flagged = 0;
 
-	buffy_maildir_update_dir (mailbox, "new");
+	buffy_maildir_update_dir (mailbox, "new", &mailbox->sb_dircount[0]);
 	if (mailbox->msg_count) {
 		mailbox->new = 1;
 	}
-	buffy_maildir_update_dir (mailbox, "cur");
+	buffy_maildir_update_dir (mailbox, "cur", &mailbox->sb_dircount[1]);
 
 	mailbox->sb_last_checked = time (NULL);
-
-	/* make sure the updates are actually put on screen */
-	sb_draw();
 }
 
 #endif
@@ -594,19 +628,30 @@ buffy_mbox_update (BUFFY *mailbox, struct stat *sb)
 		mailbox->sb_last_checked = time (NULL);
 		mx_close_mailbox (ctx, 0);
 	}
-
-	/* make sure the updates are actually put on screen */
-	sb_draw();
 }
 #endif
 
 
-static void buffy_check(BUFFY *tmp, struct stat *contex_sb)
+static void buffy_check(BUFFY *tmp, struct stat *contex_sb, int force)
 {
     struct stat sb;
 
     sb.st_size=0;
 
+#ifdef USE_INOTIFY
+    /* nothing has happened to the mailbox since it was last checked; an
+     * mbox with new mail can lose it by being read, which only shows in
+     * its atime, so that one is always looked at */
+    if (!force && mutt_monitor_is_clean (tmp) &&
+	!(tmp->new && (tmp->magic == M_MBOX || tmp->magic == M_MMDF) &&
+	  !option (OPTCHECKMBOXSIZE)))
+    {
+      if (tmp->new)
+	BuffyCount++;
+      goto notify;
+    }
+#endif
+
     if (tmp->magic != M_IMAP)
     {
       tmp->new = 0;
@@ -628,8 +673,15 @@ static void buffy_check(BUFFY *tmp, struct stat *contex_sb)
 	tmp->newly_created = 1;
 	tmp->magic = 0;
 	tmp->size = 0;
+#ifdef USE_INOTIFY
+	mutt_monitor_remove (tmp);
+#endif
 	return;
       }
+#ifdef USE_INOTIFY
+      /* watch before looking, so that no change gets lost */
+      mutt_monitor_add (tmp);
+#endif
     }
 
     /* check to see if the folder is the currently selected folder
@@ -689,6 +741,9 @@ static void buffy_check(BUFFY *tmp, struct stat *contex_sb)
     else if (option(OPTCHECKMBOXSIZE) && Context && Context->path)
       tmp->size = (off_t) sb.st_size;	/* update the size of current folder */
 
+#ifdef USE_INOTIFY
+notify:
+#endif
     if (!tmp->new)
       tmp->notified = 0;
     else if (!tmp->notified)
@@ -700,6 +755,7 @@ int mutt_buffy_check (int force)
   BUFFY *tmp;
   struct stat contex_sb;
   time_t t;
+  int changed = 0;
 
   contex_sb.st_dev=0;
   contex_sb.st_ino=0;
@@ -719,7 +775,20 @@ int mutt_buffy_check (int force)
     return 0;
 #endif
   t = time (NULL);
-  if (!force && (t - BuffyTime < BuffyTimeout))
+#ifdef USE_INOTIFY
+  /* these decide what counts as new mail, so recheck everything when
+   * they have been changed */
+  if (option (OPTMAILCHECKRECENT) != LastCheckRecent ||
+      option (OPTCHECKMBOXSIZE) != LastCheckMboxSize)
+  {
+    LastCheckRecent = option (OPTMAILCHECKRECENT);
+    LastCheckMboxSize = option (OPTCHECKMBOXSIZE);
+    mutt_monitor_changed ();
+  }
+  /* check right away when a watched mailbox has changed */
+  changed = mutt_monitor_poll ();
+#endif
+  if (!force && !changed && (t - BuffyTime < BuffyTimeout))
     return BuffyCount;
 
   BuffyTime = t;
@@ -739,19 +808,25 @@ int mutt_buffy_check (int force)
   }
 
 #ifdef USE_SIDEBAR
-  if (sb_should_refresh()) {
+  if (sb_should_refresh() || changed) {
     for (tmp = Incoming; tmp; tmp = tmp->next)
-      buffy_check(tmp, &contex_sb);
+      buffy_check(tmp, &contex_sb, force);
     sb_set_update_time();
   }
 #else
   for (tmp = Incoming; tmp; tmp = tmp->next)
-    buffy_check(tmp, &contex_sb);
+    buffy_check(tmp, &contex_sb, force);
 #endif
 
 #ifdef USE_NOTMUCH
   for (tmp = VirtIncoming; tmp; tmp = tmp->next)
-    buffy_check(tmp, &contex_sb);
+    buffy_check(tmp, &contex_sb, force);
+  nm_nonctx_release_db();
+#endif
+
+#ifdef USE_SIDEBAR
+  /* make sure the updates are actually put on screen */
+  sb_draw();
 #endif
 
   BuffyDoneTime = BuffyTime;
@@ -821,6 +896,10 @@ void mutt_buffy_setnotified (const char *path)
 
   buffy->notified = 1;
   time(&buffy->last_visited);
+#ifdef USE_INOTIFY
+  /* with $mail_check_recent, this alone may take away its new mail */
+  buffy->monitor_changed = 1;
+#endif
 }
 
 int mutt_buffy_notify (void)
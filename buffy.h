@@ -23,6 +23,30 @@
 #define M_MAILBOXES   1
 #define M_UNMAILBOXES 2 
 
+#ifdef USE_SIDEBAR
+/* message counts of a maildir directory, with the state they were taken in */
+struct buffy_dircount
+{
+  time_t mtime;
+  ino_t ino;
+  time_t counted;		/* when the directory was read */
+  int msg_count;
+  int msg_unread;
+  int msg_flagged;
+};
+
+/* formatted sidebar entry, with the state it was made from */
+struct buffy_sbentry
+{
+  char *str;
+  int msg_count;
+  int msg_unread;
+  int msg_flagged;
+  int width;
+  unsigned int generation;	/* of the sidebar settings */
+};
+#endif
+
 typedef struct buffy_t
 {
   char path[_POSIX_PATH_MAX];
@@ -46,12 +70,21 @@ typedef struct buffy_t
   time_t last_visited;		/* time of last exit from this mailbox */
 #ifdef USE_SIDEBAR
   time_t sb_last_checked;	/* time of last buffy check from sidebar */
+  struct buffy_dircount sb_dircount[2];	/* maildir new and cur */
+  struct buffy_sbentry sb_entry;	/* last drawn sidebar entry */
+#endif
+#ifdef USE_INOTIFY
+  int monitor_wd[2];		/* inotify watches (maildir new and cur) */
+  short monitor_changed;	/* events since last checked */
 #endif
 }
 BUFFY;
 
 WHERE BUFFY *Incoming INITVAL (0);
 WHERE short BuffyTimeout INITVAL (3);
+#ifdef USE_INOTIFY
+WHERE short BuffyWatchedTimeout INITVAL (300);
+#endif
 
 #ifdef USE_NOTMUCH
 WHERE BUFFY *VirtIncoming INITVAL (0);
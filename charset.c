@@ -392,6 +392,106 @@ iconv_t mutt_iconv_open (const char *tocode, const char *fromcode, int flags)
   return (iconv_t) -1;
 }
 
+/*
+ * Recently used conversion descriptors, most recent first.  Converting
+ * lots of short strings (decoded header words, mostly) would otherwise
+ * pay for a charset lookup and an iconv_open() every time.  Failed
+ * lookups are remembered as well.
+ */
+#define ICONV_CACHE_SIZE 8
+
+static struct
+{
+  char *tocode;
+  char *fromcode;
+  int flags;
+  iconv_t cd;
+} IconvCache[ICONV_CACHE_SIZE];
+
+static int IconvCacheUsed = 0;
+
+/*
+ * Like mutt_iconv_open(), but the descriptor belongs to the cache: it
+ * is reset before being returned and must not be closed by the caller.
+ * It is only good until the next call, which may evict it.
+ */
+iconv_t mutt_iconv_get (const char *tocode, const char *fromcode, int flags)
+{
+  int i;
+  char *t, *f;
+  iconv_t cd;
+
+  for (i = 0; i < IconvCacheUsed; i++)
+    if (IconvCache[i].flags == flags &&
+	!mutt_strcmp (IconvCache[i].tocode, tocode) &&
+	!mutt_strcmp (IconvCache[i].fromcode, fromcode))
+      break;
+
+  if (i < IconvCacheUsed)
+  {
+    t = IconvCache[i].tocode;
+    f = IconvCache[i].fromcode;
+    cd = IconvCache[i].cd;
+    if (cd != (iconv_t) -1)
+      iconv (cd, 0, 0, 0, 0);
+  }
+  else
+  {
+    if (IconvCacheUsed == ICONV_CACHE_SIZE)
+    {
+      i = --IconvCacheUsed;
+      FREE (&IconvCache[i].tocode);
+      FREE (&IconvCache[i].fromcode);
+      if (IconvCache[i].cd != (iconv_t) -1)
+	iconv_close (IconvCache[i].cd);
+    }
+    i = IconvCacheUsed++;
+    t = safe_strdup (tocode);
+    f = safe_strdup (fromcode);
+    cd = mutt_iconv_open (tocode, fromcode, flags);
+  }
+
+  /* move to the front */
+  memmove (IconvCache + 1, IconvCache, i * sizeof (IconvCache[0]));
+  IconvCache[0].tocode = t;
+  IconvCache[0].fromcode = f;
+  IconvCache[0].flags = flags;
+  IconvCache[0].cd = cd;
+
+  return cd;
+}
+
+/* Called when charset-hooks or iconv-hooks change. */
+void mutt_iconv_cache_flush (void)
+{
+  int i;
+
+  for (i = 0; i < IconvCacheUsed; i++)
+  {
+    FREE (&IconvCache[i].tocode);
+    FREE (&IconvCache[i].fromcode);
+    if (IconvCache[i].cd != (iconv_t) -1)
+      iconv_close (IconvCache[i].cd);
+  }
+  IconvCacheUsed = 0;
+}
+
+/*
+ * Can a string in charset chs be taken to be plain US-ASCII if it has
+ * no 8-bit characters?  That is the case for the usual suspects, but
+ * not for 7-bit stateful encodings like iso-2022-jp, or UTF-16.
+ */
+static int ascii_compatible (const char *chs)
+{
+  char buf[STRING];
+
+  mutt_canonical_charset (buf, sizeof (buf), chs);
+  return (!ascii_strcasecmp (buf, "us-ascii") ||
+	  !ascii_strncasecmp (buf, "utf-8", 5) ||
+	  !ascii_strncasecmp (buf, "iso-8859-", 9) ||
+	  !ascii_strncasecmp (buf, "windows-125", 11));
+}
+
 
 /*
  * Like iconv, but keeps going even when the input is invalid
@@ -481,7 +581,21 @@ int mutt_convert_string (char **ps, const char *from, const char *to, int flags)
   if (!s || !*s)
     return 0;
 
-  if (to && from && (cd = mutt_iconv_open (to, from, flags)) != (iconv_t)-1)
+  /* nothing to do for plain ASCII between ASCII supersets */
+  if (to && from)
+  {
+    const unsigned char *p;
+    const char *f = from, *tmp;
+
+    for (p = (const unsigned char *) s; *p && *p < 0x80; p++)
+      ;
+    if (!*p && (flags & M_ICONV_HOOK_FROM) && (tmp = mutt_charset_hook (from)))
+      f = tmp;
+    if (!*p && ascii_compatible (f) && ascii_compatible (to))
+      return 0;
+  }
+
+  if (to && from && (cd = mutt_iconv_get (to, from, flags)) != (iconv_t)-1)
   {
     int len;
     ICONV_CONST char *ib;
@@ -503,7 +617,6 @@ int mutt_convert_string (char **ps, const char *from, const char *to, int flags)
     ob = buf = safe_malloc (obl + 1);
     
     mutt_iconv (cd, &ib, &ibl, &ob, &obl, inrepls, outrepl);
-    iconv_close (cd);
 
     *ob = '\0';
 
@@ -591,6 +704,40 @@ char *fgetconvs (char *buf, size_t l, FGETCONV *_fc)
     return NULL;
 }
 
+/*
+ * Read up to l bytes of converted text into buf, without the
+ * per-character overhead of fgetconv() when no conversion is needed.
+ * Returns the number of bytes read, 0 at end of file.
+ */
+size_t fgetconv_read (char *buf, size_t l, FGETCONV *_fc)
+{
+  struct fgetconv_s *fc = (struct fgetconv_s *)_fc;
+  size_t r = 0, n;
+  int c;
+
+  if (!fc)
+    return 0;
+  if (fc->cd == (iconv_t)-1)
+    return fread (buf, 1, l, fc->file);
+
+  while (r < l)
+  {
+    if (fc->p && fc->p < fc->ob)
+    {
+      n = MIN ((size_t)(fc->ob - fc->p), l - r);
+      memcpy (buf + r, fc->p, n);
+      fc->p += n;
+      r += n;
+    }
+    else if ((c = fgetconv (_fc)) != EOF)
+      buf[r++] = (char) c;
+    else
+      break;
+  }
+
+  return r;
+}
+
 int fgetconv (FGETCONV *_fc)
 {
   struct fgetconv_s *fc = (struct fgetconv_s *)_fc;
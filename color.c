@@ -415,6 +415,15 @@ int mutt_parse_unmono (BUFFER *buf, BUFFER *s, unsigned long data,
   return _mutt_parse_uncolor(buf, s, data, err, 0);
 }
 
+/* force re-evaluation of the cached index colors */
+static void invalidate_index_colors (void)
+{
+  int i;
+
+  for (i = 0; Context && i < Context->msgcount; i++)
+    Context->hdrs[i]->color_valid = 0;
+}
+
 /**
  * mutt_do_uncolor - XXX
  */
@@ -534,11 +543,8 @@ static int _mutt_parse_uncolor (BUFFER *buf, BUFFER *s, unsigned long data,
 
   if (do_cache && !option (OPTNOCURSES))
   {
-    int i;
     set_option (OPTFORCEREDRAWINDEX);
-    /* force re-caching of index colors */
-    for (i = 0; Context && i < Context->msgcount; i++)
-      Context->hdrs[i]->pair = 0;
+    invalidate_index_colors ();
   }
   return (0);
 }
@@ -597,8 +603,6 @@ add_pattern (COLOR_LINE **top, const char *s, int sensitive,
     tmp = mutt_new_color_line ();
     if (is_index) 
     {
-      int i;
-
       strfcpy(buf, NONULL(s), sizeof(buf));
       mutt_check_simple (buf, sizeof (buf), NONULL(SimpleSearch));
       if((tmp->color_pattern = mutt_pattern_comp (buf, M_FULL_MSG, err)) == NULL)
@@ -606,9 +610,7 @@ add_pattern (COLOR_LINE **top, const char *s, int sensitive,
 	mutt_free_color_line(&tmp, 1);
 	return -1;
       }
-      /* force re-caching of index colors */
-      for (i = 0; Context && i < Context->msgcount; i++)
-	Context->hdrs[i]->pair = 0;
+      invalidate_index_colors ();
     }
     else if ((r = REGCOMP (&tmp->rx, s, (sensitive ? mutt_which_case (s) : REG_ICASE))) != 0)
     {
@@ -896,6 +898,9 @@ _mutt_parse_color (BUFFER *buf, BUFFER *s, BUFFER *err,
     ColorDefs[object] = fgbgattr_to_color(fg, bg, attr);
     if (object > MT_COLOR_INDEX_AUTHOR)
       set_option (OPTFORCEREDRAWINDEX);
+    /* the index falls back to the normal color */
+    if (object == MT_COLOR_NORMAL)
+      invalidate_index_colors ();
   }
 
   return (r);
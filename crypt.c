@@ -30,6 +30,7 @@
 #include "mime.h"
 #include "copy.h"
 #include "mutt_crypt.h"
+#include "md5.h"
 
 #include <sys/wait.h>
 #include <string.h>
@@ -51,6 +52,13 @@
 # include <sys/resource.h>
 #endif
 
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# ifndef MAP_ANONYMOUS
+#  define MAP_ANONYMOUS MAP_ANON
+# endif
+#endif
+
 
 /* print the current time to avoid spoofing of the signature output */
 void crypt_current_time(STATE *s, char *app_name)
@@ -85,6 +93,9 @@ void crypt_forget_passphrase (void)
   if ((WithCrypto & APPLICATION_SMIME))
     crypt_smime_void_passphrase ();
 
+  crypt_forget_signatures ();
+  crypt_forget_decrypted ();
+
   if (WithCrypto)
     mutt_message _("Passphrase(s) forgotten.");
 }
@@ -889,6 +900,462 @@ static void crypt_fetch_signatures (BODY ***signatures, BODY *a, int *n)
  * This routine verifies a  "multipart/signed"  body.
  */
 
+/*
+ * The output of recent good signature checks, keyed by a digest of the
+ * signed data and the signature.  Paging back and forth through a signed
+ * thread would otherwise run the external tools on the same message again
+ * and again.  An entry is only used while the keyring hasn't changed since
+ * it was made, as that can change what the check says, and for no longer
+ * than SIG_CACHE_EXPIRE seconds, as keys expire without any change to it.
+ */
+#define SIG_CACHE_SIZE 32
+#define SIG_CACHE_EXPIRE 3600
+
+static struct
+{
+  unsigned char digest[16];
+  time_t checked;
+  int rc;
+  char *output;
+  size_t len;
+} SigCache[SIG_CACHE_SIZE];
+
+static time_t crypt_file_stamp (const char *path, time_t stamp)
+{
+  struct stat st;
+
+  if (stat (path, &st) == 0 && st.st_mtime > stamp)
+    return st.st_mtime;
+  return stamp;
+}
+
+/*
+ * The latest change to the keyring used by command, or by GPGME if it is
+ * NULL, or 0 if its files aren't known or found.  For a GnuPG command, its
+ * --homedir and --keyring options are followed; for other programs, the
+ * files aren't known.  Classic S/MIME uses $smime_certificates and
+ * $smime_ca_location, whatever the command.
+ */
+time_t crypt_keyring_stamp (int smime, const char *command)
+{
+  static const char *pgpfiles[] = { "pubring.kbx", "pubring.gpg", "trustdb.gpg",
+				    "public-keys.d/pubring.db", NULL };
+  static const char *smimefiles[] = { "pubring.kbx", "trustlist.txt", NULL };
+  char homedir[_POSIX_PATH_MAX], path[_POSIX_PATH_MAX], buf[LONG_STRING];
+  const char **files;
+  LIST *keyrings = NULL, *l;
+  char *tok, *arg, *p;
+  int gnupg = 0;
+  time_t stamp = 0;
+
+  if (smime && !option (OPTCRYPTUSEGPGME))
+  {
+    /* the certificates are added and removed along with their .index */
+    if (SmimeCertificates)
+    {
+      stamp = crypt_file_stamp (SmimeCertificates, stamp);
+      snprintf (path, sizeof (path), "%s/.index", SmimeCertificates);
+      stamp = crypt_file_stamp (path, stamp);
+    }
+    if (SmimeCALocation)
+      stamp = crypt_file_stamp (SmimeCALocation, stamp);
+    return stamp;
+  }
+
+  if ((arg = getenv ("GNUPGHOME")) && *arg)
+    strfcpy (homedir, arg, sizeof (homedir));
+  else
+    snprintf (homedir, sizeof (homedir), "%s/.gnupg", NONULL (Homedir));
+
+  if (command)
+  {
+    strfcpy (buf, command, sizeof (buf));
+    for (tok = strtok (buf, " \t"); tok; tok = strtok (NULL, " \t"))
+    {
+      /* the options before the program are a wrapper's */
+      if (!gnupg)
+      {
+	p = strrchr (tok, '/');
+	gnupg = !mutt_strncmp (p ? p + 1 : tok, "gpg", 3);
+	continue;
+      }
+
+      if (mutt_strncmp (tok, "--homedir", 9) && mutt_strncmp (tok, "--keyring", 9) &&
+	  mutt_strncmp (tok, "--primary-keyring", 17))
+	continue;
+      if ((arg = strchr (tok, '=')))
+	arg++;
+      else if (!(arg = strtok (NULL, " \t")))
+	break;
+      if ((*arg == '\'' || *arg == '"') && (p = strchr (arg + 1, *arg)))
+      {
+	*p = 0;
+	arg++;
+      }
+
+      if (!mutt_strncmp (tok, "--homedir", 9))
+      {
+	strfcpy (homedir, arg, sizeof (homedir));
+	mutt_expand_path (homedir, sizeof (homedir));
+      }
+      else
+	keyrings = mutt_add_list (keyrings, arg);
+    }
+    if (!gnupg)
+      return 0;
+  }
+
+  for (files = smime ? smimefiles : pgpfiles; *files; files++)
+  {
+    snprintf (path, sizeof (path), "%s/%s", homedir, *files);
+    stamp = crypt_file_stamp (path, stamp);
+  }
+
+  /* names without a slash are in the home directory */
+  for (l = keyrings; l; l = l->next)
+  {
+    if (strchr (l->data, '/'))
+    {
+      strfcpy (path, l->data, sizeof (path));
+      mutt_expand_path (path, sizeof (path));
+    }
+    else
+      snprintf (path, sizeof (path), "%s/%s", homedir, l->data);
+    stamp = crypt_file_stamp (path, stamp);
+  }
+  mutt_free_list (&keyrings);
+
+  return stamp;
+}
+
+static int SigCacheNext = 0;
+
+void crypt_forget_signatures (void)
+{
+  int i;
+
+  for (i = 0; i < SIG_CACHE_SIZE; i++)
+  {
+    FREE (&SigCache[i].output);
+    SigCache[i].len = 0;
+  }
+  SigCacheNext = 0;
+}
+
+static int crypt_verify_one (BODY *sigbdy, STATE *s, const char *tempfile,
+			     int smime)
+{
+  struct md5_ctx ctx;
+  unsigned char digest[16];
+  char buf[LONG_STRING], capfile[_POSIX_PATH_MAX];
+  FILE *fp, *fpout;
+  LOFF_T len;
+  size_t n;
+  time_t now, stamp;
+  int i, rc;
+
+  /* the keyring the check would use, unless it is unknown */
+  if (!(stamp = crypt_keyring_stamp (smime, (smime || option (OPTCRYPTUSEGPGME))
+					    ? NULL : PgpVerifyCommand)))
+    goto nocache;
+
+  /* digest the signed data, the signature and how it is displayed */
+  md5_init_ctx (&ctx);
+  md5_process_bytes (smime ? "S" : "P", 1, &ctx);
+  md5_process_bytes (&s->flags, sizeof (s->flags), &ctx);
+  md5_process_bytes (NONULL (s->prefix), mutt_strlen (s->prefix), &ctx);
+  if ((fp = fopen (tempfile, "r")) == NULL)
+    goto nocache;
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+    md5_process_bytes (buf, n, &ctx);
+  safe_fclose (&fp);
+  fseeko (s->fpin, sigbdy->offset, 0);
+  for (len = sigbdy->length; len > 0; len -= n)
+  {
+    if ((n = fread (buf, 1, MIN (sizeof (buf), (size_t) len), s->fpin)) == 0)
+      break;
+    md5_process_bytes (buf, n, &ctx);
+  }
+  md5_finish_ctx (&ctx, digest);
+
+  /* an entry made in the second the keyring changed may be stale, too */
+  now = time (NULL);
+  for (i = 0; i < SIG_CACHE_SIZE; i++)
+    if (SigCache[i].output && !memcmp (SigCache[i].digest, digest, 16) &&
+	stamp < SigCache[i].checked && now - SigCache[i].checked < SIG_CACHE_EXPIRE)
+    {
+      fwrite (SigCache[i].output, 1, SigCache[i].len, s->fpout);
+      return SigCache[i].rc;
+    }
+
+  /* capture what the check prints, so that it can be replayed */
+  mutt_mktemp (capfile, sizeof (capfile));
+  if ((fp = safe_fopen (capfile, "w+")) == NULL)
+    goto nocache;
+
+  fpout = s->fpout;
+  s->fpout = fp;
+  if (smime)
+    rc = crypt_smime_verify_one (sigbdy, s, tempfile);
+  else
+    rc = crypt_pgp_verify_one (sigbdy, s, tempfile);
+  s->fpout = fpout;
+
+  /* a failure may be down to a missing key, which may be imported later */
+  if (rc != 0)
+  {
+    rewind (fp);
+    mutt_copy_stream (fp, s->fpout);
+    safe_fclose (&fp);
+    mutt_unlink (capfile);
+    return rc;
+  }
+
+  i = SigCacheNext;
+  SigCacheNext = (SigCacheNext + 1) % SIG_CACHE_SIZE;
+  FREE (&SigCache[i].output);
+  SigCache[i].len = ftello (fp);
+  SigCache[i].output = safe_malloc (SigCache[i].len + 1);
+  rewind (fp);
+  if (fread (SigCache[i].output, 1, SigCache[i].len, fp) != SigCache[i].len)
+    FREE (&SigCache[i].output);
+  else
+  {
+    memcpy (SigCache[i].digest, digest, 16);
+    SigCache[i].checked = now;
+    SigCache[i].rc = rc;
+    fwrite (SigCache[i].output, 1, SigCache[i].len, s->fpout);
+  }
+  safe_fclose (&fp);
+  mutt_unlink (capfile);
+
+  return rc;
+
+nocache:
+  if (smime)
+    return crypt_smime_verify_one (sigbdy, s, tempfile);
+  return crypt_pgp_verify_one (sigbdy, s, tempfile);
+}
+
+/*
+ * The output of recent decryptions, kept for $crypt_decrypt_cache
+ * kilobytes and no longer than the passphrase would be, so that
+ * displaying, replying to or searching an encrypted message again does
+ * not run the decryption again.  The plaintext is only kept in memory
+ * which could be locked, so that it is never paged out, and is wiped
+ * when it is dropped.
+ */
+struct decrypted
+{
+  unsigned char digest[16];
+  time_t expire;
+  int rc;
+  unsigned char *data;		/* plaintext, then the diagnostics */
+  size_t size;			/* allocated */
+  size_t outlen;
+  size_t errlen;
+  struct decrypted *next;
+};
+
+static struct decrypted *Decrypted = NULL;
+static size_t DecryptedSize = 0;
+
+/* Returns locked memory, or NULL if there is none to be had. */
+static unsigned char *crypt_secure_alloc (size_t size)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MLOCK)
+  unsigned char *p;
+
+  p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+	    -1, 0);
+  if (p == MAP_FAILED)
+    return NULL;
+  /* e.g. beyond RLIMIT_MEMLOCK */
+  if (mlock (p, size) != 0)
+  {
+    dprint (1, (debugfile, "crypt_secure_alloc: mlock: %s\n", strerror (errno)));
+    munmap (p, size);
+    return NULL;
+  }
+  return p;
+#else
+  return NULL;
+#endif
+}
+
+static void crypt_secure_free (unsigned char **p, size_t size)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP) && defined(HAVE_MLOCK)
+  volatile unsigned char *v = *p;
+  size_t i;
+
+  if (!*p)
+    return;
+
+  for (i = 0; i < size; i++)
+    v[i] = 0;
+
+  munlock (*p, size);
+  munmap (*p, size);
+  *p = NULL;
+#endif
+}
+
+static void crypt_drop_decrypted (struct decrypted **pd)
+{
+  struct decrypted *d = *pd;
+
+  *pd = d->next;
+  DecryptedSize -= d->size;
+  crypt_secure_free (&d->data, d->size);
+  FREE (&d);
+}
+
+void crypt_forget_decrypted (void)
+{
+  while (Decrypted)
+    crypt_drop_decrypted (&Decrypted);
+}
+
+/* Wipe the decryptions whose time is up.  Returns the number of seconds
+ * until the next one is, or 0 if none are kept. */
+int crypt_expire_decrypted (void)
+{
+  struct decrypted **pd;
+  time_t now = time (NULL);
+  int next = 0;
+
+  for (pd = &Decrypted; *pd; )
+  {
+    if ((*pd)->expire < now)
+    {
+      crypt_drop_decrypted (pd);
+      continue;
+    }
+    if (!next || (*pd)->expire - now + 1 < next)
+      next = (*pd)->expire - now + 1;
+    pd = &(*pd)->next;
+  }
+
+  return next;
+}
+
+/* Read everything from offset on in fp; leaves fp at its end. */
+static size_t crypt_read_rest (FILE *fp, LOFF_T offset, unsigned char *buf,
+			       size_t len)
+{
+  size_t n = 0;
+
+  fflush (fp);
+  if (fseeko (fp, offset, SEEK_SET) == 0)
+    n = fread (buf, 1, len, fp);
+  fseeko (fp, 0, SEEK_END);
+
+  return n;
+}
+
+/*
+ * Look up the result of decrypting length bytes at offset in fpin.  On a
+ * hit, the plaintext is written to fpout, whatever the decryption
+ * program printed to fperr, and its exit code is returned in *rc.
+ * Returns 0 on a hit, and -1 if the decryption has to be run, after
+ * which crypt_decrypted_store () may be called with digest.
+ */
+int crypt_decrypted_lookup (FILE *fpin, LOFF_T offset, LOFF_T length, int smime,
+			    unsigned char *digest, FILE *fpout, FILE *fperr,
+			    int *rc)
+{
+  struct md5_ctx ctx;
+  struct decrypted **pd;
+  char buf[LONG_STRING];
+  size_t n;
+
+  if (CryptDecryptCache <= 0)
+  {
+    crypt_forget_decrypted ();
+    return -1;
+  }
+
+  md5_init_ctx (&ctx);
+  md5_process_bytes (smime ? "S" : "P", 1, &ctx);
+  fseeko (fpin, offset, SEEK_SET);
+  for (; length > 0; length -= n)
+  {
+    if ((n = fread (buf, 1, MIN (sizeof (buf), (size_t) length), fpin)) == 0)
+      break;
+    md5_process_bytes (buf, n, &ctx);
+  }
+  md5_finish_ctx (&ctx, digest);
+
+  crypt_expire_decrypted ();
+  for (pd = &Decrypted; *pd; pd = &(*pd)->next)
+  {
+    if (!memcmp ((*pd)->digest, digest, 16))
+    {
+      fwrite ((*pd)->data, 1, (*pd)->outlen, fpout);
+      fwrite ((*pd)->data + (*pd)->outlen, 1, (*pd)->errlen, fperr);
+      *rc = (*pd)->rc;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/* Remember the plaintext written to fpout from outpos on, and the
+ * diagnostics in fperr, after a successful decryption. */
+void crypt_decrypted_store (const unsigned char *digest, int smime,
+			    FILE *fpout, LOFF_T outpos, FILE *fperr, int rc)
+{
+  struct decrypted *d, **pd;
+  size_t limit = (size_t) CryptDecryptCache * 1024;
+  LOFF_T outlen, errlen;
+  short timeout;
+
+  timeout = smime ? SmimeTimeout : PgpTimeout;
+  if (CryptDecryptCache <= 0 || timeout <= 0)
+    return;
+
+  fflush (fpout);
+  fflush (fperr);
+  fseeko (fpout, 0, SEEK_END);
+  fseeko (fperr, 0, SEEK_END);
+  outlen = ftello (fpout) - outpos;
+  errlen = ftello (fperr);
+  if (outlen <= 0 || errlen < 0 || (size_t) (outlen + errlen) >= limit)
+    return;
+
+  /* make room, dropping the oldest entries first */
+  while (Decrypted && DecryptedSize + outlen + errlen > limit)
+    crypt_drop_decrypted (&Decrypted);
+
+  d = safe_calloc (1, sizeof (struct decrypted));
+  d->size = outlen + errlen + 1;
+  if ((d->data = crypt_secure_alloc (d->size)) == NULL)
+  {
+    FREE (&d);
+    return;
+  }
+
+  d->outlen = crypt_read_rest (fpout, outpos, d->data, outlen);
+  d->errlen = crypt_read_rest (fperr, 0, d->data + d->outlen, errlen);
+  if (d->outlen != (size_t) outlen || d->errlen != (size_t) errlen)
+  {
+    crypt_secure_free (&d->data, d->size);
+    FREE (&d);
+    return;
+  }
+
+  memcpy (d->digest, digest, 16);
+  d->rc = rc;
+  d->expire = time (NULL) + timeout;
+  DecryptedSize += d->size;
+
+  for (pd = &Decrypted; *pd; pd = &(*pd)->next)
+    ;
+  *pd = d;
+}
+
 int mutt_signed_handler (BODY *a, STATE *s)
 {
   char tempfile[_POSIX_PATH_MAX];
@@ -966,7 +1433,7 @@ int mutt_signed_handler (BODY *a, STATE *s)
               && signatures[i]->type == TYPEAPPLICATION 
 	      && !ascii_strcasecmp (signatures[i]->subtype, "pgp-signature"))
 	  {
-	    if (crypt_pgp_verify_one (signatures[i], s, tempfile) != 0)
+	    if (crypt_verify_one (signatures[i], s, tempfile, 0) != 0)
 	      goodsig = 0;
 	    
 	    continue;
@@ -977,7 +1444,7 @@ int mutt_signed_handler (BODY *a, STATE *s)
 	      && (!ascii_strcasecmp(signatures[i]->subtype, "x-pkcs7-signature")
 		  || !ascii_strcasecmp(signatures[i]->subtype, "pkcs7-signature")))
 	  {
-	    if (crypt_smime_verify_one (signatures[i], s, tempfile) != 0)
+	    if (crypt_verify_one (signatures[i], s, tempfile, 1) != 0)
 	      goodsig = 0;
 	    
 	    continue;
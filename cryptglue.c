@@ -232,6 +232,7 @@ BODY *crypt_pgp_encrypt_message (BODY *a, char *keylist, int sign)
 /* Invoke the PGP command to import a key. */
 void crypt_pgp_invoke_import (const char *fname)
 {
+  crypt_forget_signatures ();
   if (CRYPT_MOD_CALL_CHECK (PGP, pgp_invoke_import))
     (CRYPT_MOD_CALL (PGP, pgp_invoke_import)) (fname);
 }
@@ -258,6 +259,7 @@ int crypt_pgp_send_menu (HEADER *msg, int *redraw)
 /* fixme: needs documentation */
 void crypt_pgp_extract_keys_from_attachment_list (FILE *fp, int tag, BODY *top)
 {
+  crypt_forget_signatures ();
   if (CRYPT_MOD_CALL_CHECK (PGP, pgp_extract_keys_from_attachment_list))
     (CRYPT_MOD_CALL (PGP, pgp_extract_keys_from_attachment_list)) (fp, tag, top);
 }
@@ -367,6 +369,7 @@ BODY *crypt_smime_build_smime_entity (BODY *a, char *certlist)
 /* Add a certificate and update index file (externally). */
 void crypt_smime_invoke_import (char *infile, char *mailbox)
 {
+  crypt_forget_signatures ();
   if (CRYPT_MOD_CALL_CHECK (SMIME, smime_invoke_import))
     (CRYPT_MOD_CALL (SMIME, smime_invoke_import)) (infile, mailbox);
 }
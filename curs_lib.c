@@ -48,6 +48,11 @@
 #include "mutt_notmuch.h"
 #endif
 
+#ifdef USE_INOTIFY
+#include "monitor.h"
+#include <poll.h>
+#endif
+
 /* not possible to unget more than one char under some curses libs, and it
  * is impossible to unget function keys in SLang, so roll our own input
  * buffering routines.
@@ -92,6 +97,59 @@ void mutt_need_hard_redraw (void)
   set_option (OPTNEEDREDRAW);
 }
 
+static int MuttGetchTimeout = -1;
+
+/* like timeout(3), the delay is also used to wait for mailbox changes */
+void mutt_getch_timeout (int delay)
+{
+  MuttGetchTimeout = delay;
+  timeout (delay);
+}
+
+#ifdef USE_INOTIFY
+/*
+ * getch() which also returns ERR, as on timeout, when a watched mailbox
+ * changes; only if a timeout was asked for, though, as callers reading a
+ * single key (e.g. mutt_yesorno()) take ERR for an abort.
+ */
+static int getch_or_monitor (void)
+{
+  struct pollfd fds[2];
+  int ch;
+
+  if (mutt_monitor_fd () < 0)
+    return getch ();
+
+  FOREVER
+  {
+    /* curses may have read ahead already */
+    timeout (0);
+    ch = getch ();
+    timeout (MuttGetchTimeout);
+    if (ch != ERR)
+      return ch;
+
+    fds[0].fd = 0;
+    fds[0].events = POLLIN;
+    fds[1].fd = mutt_monitor_fd ();
+    fds[1].events = POLLIN;
+
+    switch (poll (fds, 2, MuttGetchTimeout))
+    {
+      case -1:		/* interrupted, e.g. SIGINT or SIGWINCH */
+      case 0:
+	return ERR;
+    }
+    if (fds[0].revents)
+      return getch ();
+
+    mutt_monitor_poll ();
+    if (MuttGetchTimeout >= 0)
+      return ERR;
+  }
+}
+#endif
+
 event_t mutt_getch (void)
 {
   int ch;
@@ -112,7 +170,11 @@ event_t mutt_getch (void)
   ch = KEY_RESIZE;
   while (ch == KEY_RESIZE)
 #endif /* KEY_RESIZE */
+#ifdef USE_INOTIFY
+    ch = getch_or_monitor ();
+#else
     ch = getch ();
+#endif
   mutt_allow_interrupt (0);
 
   if (SigInt)
@@ -318,7 +380,7 @@ void mutt_query_exit (void)
   mutt_flushinp ();
   curs_set (1);
   if (Timeout)
-    timeout (-1); /* restore blocking operation */
+    mutt_getch_timeout (-1); /* restore blocking operation */
   if (mutt_yesorno (_("Exit Mutt?"), M_YES) == M_YES)
   {
     endwin ();
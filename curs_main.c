@@ -256,20 +256,59 @@ void index_make_entry (char *s, size_t l, MUTTMENU *menu, int num)
     }
   }
 
+  if (h->index_line && h->index_line_gen == IndexLineGen &&
+      h->index_line_flags == flag && h->index_line_cols == COLS)
+  {
+    strfcpy (s, h->index_line, l);
+    return;
+  }
+
   _mutt_make_string (s, l, NONULL (HdrFmt), Context, h, flag);
+
+  mutt_str_replace (&h->index_line, s);
+  h->index_line_gen = IndexLineGen;
+  h->index_line_flags = flag;
+  h->index_line_cols = COLS;
 }
 
 int index_color (int index_no)
 {
   HEADER *h = Context->hdrs[Context->v2r[index_no]];
 
-  if (h && h->pair)
+  if (h && h->color_valid)
     return h->pair;
 
   mutt_set_header_color (Context, h);
   return h->pair;
 }
 
+static int is_motion_op (int op)
+{
+  switch (op)
+  {
+    case OP_BOTTOM_PAGE:
+    case OP_FIRST_ENTRY:
+    case OP_MIDDLE_PAGE:
+    case OP_HALF_UP:
+    case OP_HALF_DOWN:
+    case OP_NEXT_LINE:
+    case OP_PREV_LINE:
+    case OP_NEXT_PAGE:
+    case OP_PREV_PAGE:
+    case OP_LAST_ENTRY:
+    case OP_TOP_PAGE:
+    case OP_CURRENT_TOP:
+    case OP_CURRENT_MIDDLE:
+    case OP_CURRENT_BOTTOM:
+    case OP_NEXT_ENTRY:
+    case OP_PREV_ENTRY:
+    case OP_MAIN_NEXT_UNDELETED:
+    case OP_MAIN_PREV_UNDELETED:
+      return 1;
+  }
+  return 0;
+}
+
 static int ci_next_undeleted (int msgno)
 {
   int i;
@@ -732,7 +771,10 @@ int mutt_index_menu (void)
 
       index_hint = (Context->vcount && menu->current >= 0 && menu->current < Context->vcount) ? CURHDR->index : 0;
 
-      if ((check = mx_check_mailbox (Context, &index_hint, 0)) < 0)
+      if ((check = mx_check_mailbox (Context, &index_hint, 0)) != 0)
+	IndexLineGen++;
+
+      if (check < 0)
       {
 	if (!Context->path)
 	{
@@ -892,7 +934,11 @@ int mutt_index_menu (void)
       dprint(4, (debugfile, "mutt_index_menu[%d]: Got op %d\n", __LINE__, op));
 
       if (op == -1)
+      {
+	/* relative dates and the like may have changed meanwhile */
+	IndexLineGen++;
 	continue; /* either user abort or timeout */
+      }
 
       mutt_curs_set (1);
 
@@ -973,6 +1019,10 @@ int mutt_index_menu (void)
       nm_debug_check(Context);
 #endif
 
+    /* plain cursor motion leaves the cached index lines valid */
+    if (!is_motion_op (op))
+      IndexLineGen++;
+
     switch (op)
     {
 
@@ -1434,29 +1484,11 @@ int mutt_index_menu (void)
         }
 	if (tag)
 	{
-	  char msgbuf[STRING];
-	  progress_t progress;
-	  int px;
-
-	  if (!Context->quiet) {
-	    snprintf(msgbuf, sizeof (msgbuf), _("Update labels..."));
-	    mutt_progress_init(&progress, msgbuf, M_PROGRESS_MSG,
-				   1, Context->tagged);
-	  }
-	  nm_longrun_init(Context, TRUE);
-	  for (px = 0, j = 0; j < Context->vcount; j++) {
-	    if (Context->hdrs[Context->v2r[j]]->tagged) {
-	      if (!Context->quiet)
-		mutt_progress_update(&progress, ++px, -1);
-	      nm_modify_message_tags(Context, Context->hdrs[Context->v2r[j]], buf);
-	      if (op == OP_MAIN_MODIFY_LABELS_THEN_HIDE)
-	      {
-		Context->hdrs[Context->v2r[j]]->quasi_deleted = TRUE;
-	        Context->changed = TRUE;
-	      }
-	    }
+	  if (nm_modify_tagged_tags(Context, buf,
+			op == OP_MAIN_MODIFY_LABELS_THEN_HIDE) < 0) {
+	    mutt_message _("Failed to modify labels, aborting.");
+	    break;
 	  }
-	  nm_longrun_done(Context);
 	  menu->redraw = REDRAW_STATUS | REDRAW_INDEX;
 	}
 	else
@@ -2687,18 +2719,24 @@ int mutt_index_menu (void)
   return (close);
 }
 
-void mutt_set_header_color (CONTEXT *ctx, HEADER *curhdr)
+static int header_color (COLOR_LINE *color, CONTEXT *ctx, HEADER *curhdr, int def)
 {
-  COLOR_LINE *color;
+  for (; color; color = color->next)
+    if (mutt_pattern_exec (color->color_pattern, M_MATCH_FULL_ADDRESS, ctx, curhdr))
+      return color->pair;
+  return def;
+}
 
+/* Evaluate the index color rules for a message.  The results are cached
+ * in the header until its flags change or the rules are modified. */
+void mutt_set_header_color (CONTEXT *ctx, HEADER *curhdr)
+{
   if (!curhdr)
     return;
 
-  for (color = ColorIndexList; color; color = color->next)
-   if (mutt_pattern_exec (color->color_pattern, M_MATCH_FULL_ADDRESS, ctx, curhdr))
-   {
-      curhdr->pair = color->pair;
-      return;
-   }
-  curhdr->pair = ColorDefs[MT_COLOR_NORMAL];
+  curhdr->pair = header_color (ColorIndexList, ctx, curhdr, ColorDefs[MT_COLOR_NORMAL]);
+  curhdr->author_pair = header_color (ColorIndexAuthorList, ctx, curhdr, 0);
+  curhdr->flags_pair = header_color (ColorIndexFlagsList, ctx, curhdr, 0);
+  curhdr->subject_pair = header_color (ColorIndexSubjectList, ctx, curhdr, 0);
+  curhdr->color_valid = 1;
 }
@@ -259,7 +259,10 @@ void _mutt_set_flag (CONTEXT *ctx, HEADER *h, int flag, int bf, int upd_ctx)
   }
 
   if (update)
+  {
     mutt_set_header_color(ctx, h);
+    IndexLineGen++;
+  }
 
   /* if the message status has changed, we need to invalidate the cached
    * search results so that any future search will match the current status
@@ -172,6 +172,7 @@ WHERE LIST *AttachAllow INITVAL(0);
 WHERE LIST *AttachExclude INITVAL(0);
 WHERE LIST *InlineAllow INITVAL(0);
 WHERE LIST *InlineExclude INITVAL(0);
+WHERE unsigned int AttachStamp INITVAL (0); /* checksum of the lists above */
 WHERE LIST *HeaderOrderList INITVAL(0);
 WHERE LIST *Ignore INITVAL(0);
 WHERE LIST *MailtoAllow INITVAL(0);
@@ -218,6 +219,9 @@ WHERE short Wrap;
 WHERE short WrapHeaders;
 WHERE short WriteInc;
 
+/* bumped whenever cached index lines (HEADER->index_line) may be stale */
+WHERE unsigned int IndexLineGen INITVAL (1);
+
 WHERE short ScoreThresholdDelete;
 WHERE short ScoreThresholdRead;
 WHERE short ScoreThresholdFlag;
@@ -246,6 +250,7 @@ WHERE ALIAS *Aliases INITVAL (0);
 WHERE LIST *UserHeader INITVAL (0);
 
 /*-- formerly in pgp.h --*/
+WHERE short CryptDecryptCache;
 WHERE REGEXP PgpGoodSign;
 WHERE REGEXP PgpDecryptionOkay;
 WHERE char *PgpSignAs;
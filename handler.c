@@ -39,6 +39,7 @@
 
 #define BUFI_SIZE 1000
 #define BUFO_SIZE 2000
+#define BUFB_SIZE 8192
 
 
 typedef int (*handler_t) (BODY *, STATE *);
@@ -213,8 +214,8 @@ static void qp_decode_line (char *dest, char *src, size_t *l,
  * quoted-printable.  That means that we always can store the
  * result in a buffer of at most the _same_ size.
  * 
- * Now, we don't special-case if the line we read with fgets()
- * isn't terminated.  We don't care about this, since STRING > 78,
+ * Now, we don't special-case if the line we take from the input
+ * block isn't terminated.  We don't care about this, since STRING > 78,
  * so corrupted input will just be corrupted a bit more.  That
  * implies that STRING+1 bytes are always sufficient to store the
  * result of qp_decode_line.
@@ -225,45 +226,65 @@ static void qp_decode_line (char *dest, char *src, size_t *l,
  * memory to store the decoded data.
  * 
  * Just to make sure that I didn't make some off-by-one error
- * above, we just use STRING*2 for the target buffer's size.
+ * above, we just use STRING*2 for each line.  Decoded lines are
+ * collected until BUFO_SIZE bytes have piled up before they are
+ * converted, so the target buffer is that much larger.
  * 
  */
 
 static void mutt_decode_quoted (STATE *s, long len, int istext, iconv_t cd)
 {
+  char inbuf[BUFB_SIZE];
   char line[STRING];
-  char decline[2*STRING];
+  char decline[BUFO_SIZE + 2*STRING];
   size_t l = 0;
   size_t linelen;      /* number of input bytes in `line' */
   size_t l3;
+  size_t n = 0, pos = 0, chunk;
+  char *nl;
   
   int last;    /* store the last character in the input line */
   
   if (istext)
     state_set_prefix(s);
 
-  while (len > 0)
+  for (;;)
   {
-    last = 0;
-    
     /*
-     * It's ok to use a fixed size buffer for input, even if the line turns
-     * out to be longer than this.  Just process the line in chunks.  This
-     * really shouldn't happen according the MIME spec, since Q-P encoded
-     * lines are at most 76 characters, but we should be liberal about what
-     * we accept.
+     * Take the next line out of the input block.  It's ok to use a fixed
+     * size buffer for the line, even if it turns out to be longer than
+     * this.  Just process the line in chunks.  This really shouldn't
+     * happen according the MIME spec, since Q-P encoded lines are at most
+     * 76 characters, but we should be liberal about what we accept.
      */
-    if (fgets (line, MIN ((ssize_t)sizeof (line), len + 1), s->fpin) == NULL)
+    linelen = 0;
+    nl = NULL;
+    while (!nl && linelen < sizeof (line) - 1)
+    {
+      if (pos == n)
+      {
+	pos = n = 0;
+	if (len <= 0 ||
+	    (n = fread (inbuf, 1, MIN ((long) sizeof (inbuf), len), s->fpin)) == 0)
+	  break;
+	len -= n;
+      }
+      chunk = MIN (n - pos, sizeof (line) - 1 - linelen);
+      if ((nl = memchr (inbuf + pos, '\n', chunk)) != NULL)
+	chunk = nl - (inbuf + pos) + 1;
+      memcpy (line + linelen, inbuf + pos, chunk);
+      linelen += chunk;
+      pos += chunk;
+    }
+    if (!linelen)
       break;
-
-    linelen = strlen(line);
-    len -= linelen;
+    line[linelen] = 0;
 
     /*
      * inspect the last character we read so we can tell if we got the
      * entire line.
      */
-    last = linelen ? line[linelen - 1] : 0;
+    last = line[linelen - 1];
 
     /* chop trailing whitespace if we got the full line */
     if (last == '\n')
@@ -273,92 +294,124 @@ static void mutt_decode_quoted (STATE *s, long len, int istext, iconv_t cd)
       line[linelen]=0;
     }
 
-    /* decode and do character set conversion */
+    /* decode, and do character set conversion once a block has piled up */
     qp_decode_line (decline + l, line, &l3, last);
     l += l3;
-    mutt_convert_to_state (cd, decline, &l, s);
+    if (l >= BUFO_SIZE)
+      mutt_convert_to_state (cd, decline, &l, s);
   }
 
+  mutt_convert_to_state (cd, decline, &l, s);
   mutt_convert_to_state (cd, 0, 0, s);
   state_reset_prefix(s);
 }
 
+/* 
+ * Decode base64.  The input is read in blocks rather than a character
+ * at a time; characters outside the base64 alphabet are skipped, and
+ * decoding stops at the padding that ends the data.
+ */
+
 void mutt_decode_base64 (STATE *s, long len, int istext, iconv_t cd)
 {
-  char buf[5];
-  int c1, c2, c3, c4, ch, cr = 0, i;
+  unsigned char inbuf[BUFB_SIZE], *p, *end;
+  char buf[4];
+  int c1, c2, c3, c4, ch, cr = 0, i = 0, pad, done = 0;
   char bufi[BUFI_SIZE];
-  size_t l = 0;
-
-  buf[4] = 0;
+  size_t l = 0, n;
 
   if (istext) 
     state_set_prefix(s);
 
-  while (len > 0)
+  while (len > 0 && !done)
   {
-    for (i = 0 ; i < 4 && len > 0 ; len--)
-    {
-      if ((ch = fgetc (s->fpin)) == EOF)
-	break;
-      if (ch >= 0 && ch < 128 && (base64val(ch) != -1 || ch == '='))
-	buf[i++] = ch;
-    }
-    if (i != 4)
-    {
-      /* "i" may be zero if there is trailing whitespace, which is not an error */
-      if (i != 0)
-	dprint (2, (debugfile, "%s:%d [mutt_decode_base64()]: "
-	      "didn't get a multiple of 4 chars.\n", __FILE__, __LINE__));
+    if ((n = fread (inbuf, 1, MIN ((long) sizeof (inbuf), len), s->fpin)) == 0)
       break;
-    }
+    len -= n;
+
+    for (p = inbuf, end = inbuf + n; p < end; )
+    {
+      /* fast path: a complete quadruple without padding or line breaks */
+      if (i == 0 && end - p >= 4 &&
+	  p[0] < 128 && (c1 = base64val (p[0])) != -1 &&
+	  p[1] < 128 && (c2 = base64val (p[1])) != -1 &&
+	  p[2] < 128 && (c3 = base64val (p[2])) != -1 &&
+	  p[3] < 128 && (c4 = base64val (p[3])) != -1)
+      {
+	p += 4;
+	pad = 0;
+      }
+      else
+      {
+	ch = *p++;
+	if (ch < 128 && (base64val(ch) != -1 || ch == '='))
+	  buf[i++] = ch;
+	if (i != 4)
+	  continue;
+	i = 0;
+
+	c1 = base64val (buf[0]);
+	c2 = base64val (buf[1]);
+	c3 = base64val (buf[2]);
+	c4 = base64val (buf[3]);
+	pad = buf[2] == '=' ? 2 : (buf[3] == '=' ? 1 : 0);
+      }
 
-    c1 = base64val (buf[0]);
-    c2 = base64val (buf[1]);
-    ch = (c1 << 2) | (c2 >> 4);
+      ch = (c1 << 2) | (c2 >> 4);
 
-    if (cr && ch != '\n') 
-      bufi[l++] = '\r';
+      if (cr && ch != '\n') 
+	bufi[l++] = '\r';
 
-    cr = 0;
+      cr = 0;
       
-    if (istext && ch == '\r')
-      cr = 1;
-    else
-      bufi[l++] = ch;
+      if (istext && ch == '\r')
+	cr = 1;
+      else
+	bufi[l++] = ch;
 
-    if (buf[2] == '=')
-      break;
-    c3 = base64val (buf[2]);
-    ch = ((c2 & 0xf) << 4) | (c3 >> 2);
+      if (pad == 2)
+      {
+	done = 1;
+	break;
+      }
+      ch = ((c2 & 0xf) << 4) | (c3 >> 2);
 
-    if (cr && ch != '\n')
-      bufi[l++] = '\r';
+      if (cr && ch != '\n')
+	bufi[l++] = '\r';
 
-    cr = 0;
+      cr = 0;
 
-    if (istext && ch == '\r')
-      cr = 1;
-    else
-      bufi[l++] = ch;
+      if (istext && ch == '\r')
+	cr = 1;
+      else
+	bufi[l++] = ch;
 
-    if (buf[3] == '=') break;
-    c4 = base64val (buf[3]);
-    ch = ((c3 & 0x3) << 6) | c4;
+      if (pad == 1)
+      {
+	done = 1;
+	break;
+      }
+      ch = ((c3 & 0x3) << 6) | c4;
 
-    if (cr && ch != '\n')
-      bufi[l++] = '\r';
-    cr = 0;
+      if (cr && ch != '\n')
+	bufi[l++] = '\r';
+      cr = 0;
 
-    if (istext && ch == '\r')
-      cr = 1;
-    else
-      bufi[l++] = ch;
+      if (istext && ch == '\r')
+	cr = 1;
+      else
+	bufi[l++] = ch;
     
-    if (l + 8 >= sizeof (bufi))
-      mutt_convert_to_state (cd, bufi, &l, s);
+      if (l + 8 >= sizeof (bufi))
+	mutt_convert_to_state (cd, bufi, &l, s);
+    }
   }
 
+  /* "i" may be zero if there is trailing whitespace, which is not an error */
+  if (!done && i != 0)
+    dprint (2, (debugfile, "%s:%d [mutt_decode_base64()]: "
+		"didn't get a multiple of 4 chars.\n", __FILE__, __LINE__));
+
   if (cr) bufi[l++] = '\r';
 
   mutt_convert_to_state (cd, bufi, &l, s);
@@ -1007,14 +1060,12 @@ static int alternative_handler (BODY *a, STATE *s)
   if (a->encoding == ENCBASE64 || a->encoding == ENCQUOTEDPRINTABLE ||
       a->encoding == ENCUUENCODED)
   {
-    struct stat st;
     mustfree = 1;
-    fstat (fileno (s->fpin), &st);
     b = mutt_new_body ();
-    b->length = (long) st.st_size;
+    b->length = a->length;
     b->parts = mutt_parse_multipart (s->fpin,
 		  mutt_get_parameter ("boundary", a->parameter),
-		  (long) st.st_size, ascii_strcasecmp ("digest", a->subtype) == 0);
+		  a->length, ascii_strcasecmp ("digest", a->subtype) == 0);
   }
   else
     b = a;
@@ -1148,7 +1199,6 @@ static int alternative_handler (BODY *a, STATE *s)
 /* handles message/rfc822 body parts */
 static int message_handler (BODY *a, STATE *s)
 {
-  struct stat st;
   BODY *b;
   LOFF_T off_start;
   int rc = 0;
@@ -1157,9 +1207,8 @@ static int message_handler (BODY *a, STATE *s)
   if (a->encoding == ENCBASE64 || a->encoding == ENCQUOTEDPRINTABLE || 
       a->encoding == ENCUUENCODED)
   {
-    fstat (fileno (s->fpin), &st);
     b = mutt_new_body ();
-    b->length = (LOFF_T) st.st_size;
+    b->length = a->length;
     b->parts = mutt_parse_messageRFC822 (s->fpin, b);
   }
   else
@@ -1228,19 +1277,17 @@ static int multipart_handler (BODY *a, STATE *s)
 {
   BODY *b, *p;
   char length[5];
-  struct stat st;
   int count;
   int rc = 0;
 
   if (a->encoding == ENCBASE64 || a->encoding == ENCQUOTEDPRINTABLE ||
       a->encoding == ENCUUENCODED)
   {
-    fstat (fileno (s->fpin), &st);
     b = mutt_new_body ();
-    b->length = (long) st.st_size;
+    b->length = a->length;
     b->parts = mutt_parse_multipart (s->fpin,
 		  mutt_get_parameter ("boundary", a->parameter),
-		  (long) st.st_size, ascii_strcasecmp ("digest", a->subtype) == 0);
+		  a->length, ascii_strcasecmp ("digest", a->subtype) == 0);
   }
   else
     b = a;
@@ -1590,11 +1637,21 @@ static int text_plain_handler (BODY *b, STATE *s)
   return 0;
 }
 
+#ifdef USE_FMEMOPEN
+/* parts which decode to more than this are decoded to a tempfile */
+#define MEM_DECODE_MAX (1024 * 1024)
+#endif
+
 static int run_decode_and_handler (BODY *b, STATE *s, handler_t handler, int plaintext)
 {
   int origType;
   char *savePrefix = NULL;
   FILE *fp = NULL;
+#ifdef USE_FMEMOPEN
+  char *temp = NULL;
+  size_t tempsize = 0;
+  int inmem = 0;
+#endif
   char tempfile[_POSIX_PATH_MAX];
   size_t tmplength = 0;
   LOFF_T tmpoffset = 0;
@@ -1618,12 +1675,32 @@ static int run_decode_and_handler (BODY *b, STATE *s, handler_t handler, int pla
     {
       /* decode to a tempfile, saving the original destination */
       fp = s->fpout;
-      mutt_mktemp (tempfile, sizeof (tempfile));
-      if ((s->fpout = safe_fopen (tempfile, "w")) == NULL)
+#ifdef USE_FMEMOPEN
+      /* the decoded part is read back straight away, so keep small parts
+       * in memory rather than writing them out to $tmpdir; the encoded
+       * size is a good enough guess at the decoded one */
+      if (b->length <= MEM_DECODE_MAX)
       {
-        mutt_error _("Unable to open temporary file!");
-        dprint (1, (debugfile, "Can't open %s.\n", tempfile));
-        return -1;
+	if ((s->fpout = open_memstream (&temp, &tempsize)) == NULL)
+	{
+	  mutt_error _("Unable to open memory stream!");
+	  dprint (1, (debugfile, "Can't open memory stream.\n"));
+	  s->fpout = fp;
+	  return -1;
+	}
+	inmem = 1;
+      }
+      else
+#endif
+      {
+	mutt_mktemp (tempfile, sizeof (tempfile));
+	if ((s->fpout = safe_fopen (tempfile, "w")) == NULL)
+	{
+	  mutt_error _("Unable to open temporary file!");
+	  dprint (1, (debugfile, "Can't open %s.\n", tempfile));
+	  s->fpout = fp;
+	  return -1;
+	}
       }
       /* decoding the attachment changes the size and offset, so save a copy
         * of the "real" values now, and restore them after processing
@@ -1653,8 +1730,32 @@ static int run_decode_and_handler (BODY *b, STATE *s, handler_t handler, int pla
       /* restore final destination and substitute the tempfile for input */
       s->fpout = fp;
       fp = s->fpin;
-      s->fpin = fopen (tempfile, "r");
-      unlink (tempfile);
+#ifdef USE_FMEMOPEN
+      if (inmem)
+      {
+	/* fmemopen() can't cope with an empty buffer */
+	if (tempsize)
+	  s->fpin = fmemopen (temp, tempsize, "r");
+	else
+	  s->fpin = fopen ("/dev/null", "r");
+	if (s->fpin == NULL)
+	{
+	  mutt_perror (_("Unable to open memory stream!"));
+	  s->fpin = fp;
+	  s->prefix = savePrefix;
+	  b->length = tmplength;
+	  b->offset = tmpoffset;
+	  b->type = origType;
+	  FREE (&temp);
+	  return -1;
+	}
+      }
+      else
+#endif
+      {
+	s->fpin = fopen (tempfile, "r");
+	unlink (tempfile);
+      }
 
       /* restore the prefix */
       s->prefix = savePrefix;
@@ -1683,6 +1784,9 @@ static int run_decode_and_handler (BODY *b, STATE *s, handler_t handler, int pla
       s->fpin = fp;
     }
   }
+#ifdef USE_FMEMOPEN
+  FREE (&temp);
+#endif
   s->flags |= M_FIRSTDONE;
 
   return rc;
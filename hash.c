@@ -127,6 +127,26 @@ void *hash_find_hash (const HASH * table, int hash, const char *key)
   return NULL;
 }
 
+/* Walks all the elements stored under key, as with allow_dup: pass NULL
+ * as last for the first one, then the one returned before.  Returns NULL
+ * when there are no more. */
+struct hash_elem *hash_find_all (const HASH * table, const char *key,
+				 struct hash_elem *last)
+{
+  struct hash_elem *ptr;
+
+  if (last)
+    ptr = last->next;
+  else
+    ptr = table->table[table->hash_string ((unsigned char *) key, table->nelem)];
+  for (; ptr; ptr = ptr->next)
+  {
+    if (table->cmp_string (key, ptr->key) == 0)
+      return ptr;
+  }
+  return NULL;
+}
+
 void hash_delete_hash (HASH * table, int hash, const char *key, const void *data,
 		       void (*destroy) (void *))
 {
@@ -42,6 +42,8 @@ HASH;
 HASH *hash_create (int nelem, int lower);
 int hash_insert (HASH * table, const char *key, void *data, int allow_dup);
 void *hash_find_hash (const HASH * table, int hash, const char *key);
+struct hash_elem *hash_find_all (const HASH * table, const char *key,
+				 struct hash_elem *last);
 void hash_delete_hash (HASH * table, int hash, const char *key, const void *data,
 		       void (*destroy) (void *));
 void hash_destroy (HASH ** hash, void (*destroy) (void *));
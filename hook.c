@@ -84,6 +84,9 @@ int mutt_parse_hook (BUFFER *buf, BUFFER *s, unsigned long data, BUFFER *err)
     goto error;
   }
 
+  if (data & (M_CHARSETHOOK | M_ICONVHOOK))
+    mutt_iconv_cache_flush ();
+
   if (data & (M_FOLDERHOOK | M_MBOXHOOK))
   {
     /* Accidentally using the ^ mailbox shortcut in the .muttrc is a
@@ -233,6 +236,8 @@ static void delete_hooks (int type)
   HOOK *h;
   HOOK *prev;
 
+  mutt_iconv_cache_flush ();
+
   while (h = Hooks, h && (type == 0 || type == h->type))
   {
     Hooks = h->next;
@@ -1354,6 +1354,23 @@ int imap_close_mailbox (CONTEXT* ctx)
 
   if (ctx == idata->ctx)
   {
+#if USE_HCACHE
+    /* save attachment counts worked out for %X or ~X, so that they
+     * needn't be recomputed by downloading the messages next time */
+    for (i = 0; i < ctx->msgcount; i++)
+    {
+      HEADER *h = ctx->hdrs[i];
+
+      if (!h || !h->data || !h->attach_dirty || h->changed || h->deleted)
+	continue;
+      if (!idata->hcache && !(idata->hcache = imap_hcache_open (idata, NULL)))
+	break;
+      imap_hcache_put (idata, h);
+      h->attach_dirty = 0;
+    }
+    imap_hcache_close (idata);
+#endif
+
     if (idata->status != IMAP_FATAL && idata->state >= IMAP_SELECTED)
     {
       /* mx_close_mailbox won't sync if there are no deleted messages
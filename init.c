@@ -907,6 +907,25 @@ bail:
   return -1;
 }
 
+static unsigned int attach_list_stamp (unsigned int stamp, LIST *lp, char op)
+{
+  ATTACH_MATCH *a;
+  const char *p;
+
+  for (; lp; lp = lp->next)
+  {
+    a = (ATTACH_MATCH *) lp->data;
+    stamp = stamp * 33 + op;
+    for (p = NONULL (a->major); *p; p++)
+      stamp = stamp * 33 + (unsigned char) *p;
+    stamp = stamp * 33 + '/';
+    for (p = NONULL (a->minor); *p; p++)
+      stamp = stamp * 33 + (unsigned char) *p;
+  }
+
+  return stamp;
+}
+
 /* always wise to do what someone else did before */
 static void _attachments_clean (void)
 {
@@ -916,6 +935,13 @@ static void _attachments_clean (void)
     for (i = 0; i < Context->msgcount; i++)
       Context->hdrs[i]->attach_valid = 0;
   }
+
+  /* attachment counts kept in the header cache were worked out with
+   * the rules in effect at the time, so fingerprint the current ones */
+  AttachStamp = attach_list_stamp (0, AttachAllow, 'A');
+  AttachStamp = attach_list_stamp (AttachStamp, AttachExclude, 'a');
+  AttachStamp = attach_list_stamp (AttachStamp, InlineAllow, 'I');
+  AttachStamp = attach_list_stamp (AttachStamp, InlineExclude, 'i');
 }
 
 static int parse_attach_list (BUFFER *buf, BUFFER *s, LIST **ldata, BUFFER *err)
@@ -2355,6 +2381,9 @@ int mutt_parse_rc_line (/* const */ char *line, BUFFER *token, BUFFER *err)
 
   *err->data = 0;
 
+  /* almost any command can change how index lines are rendered */
+  IndexLineGen++;
+
   SKIPWS (expn.dptr);
   while (*expn.dptr)
   {
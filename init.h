@@ -500,6 +500,18 @@ struct option_t MuttVars[] = {
   ** be presented.  This is generally considered unsafe, especially where
   ** typos are concerned.
   */
+  { "crypt_decrypt_cache",	DT_NUM,	 R_NONE, UL &CryptDecryptCache, 0 },
+  /*
+  ** .pp
+  ** If set to a value greater than zero, Mutt keeps up to this many
+  ** kilobytes of decrypted PGP and S/MIME messages in memory, so that
+  ** viewing, replying to or searching an encrypted message again does
+  ** not decrypt it again.  Messages are only kept in locked memory, so
+  ** nothing is kept where the system doesn't allow locking it (see
+  ** \fCulimit -l\fP).  Each message is forgotten after $$pgp_timeout or
+  ** $$smime_timeout seconds, when the passphrases are forgotten, and when
+  ** Mutt exits.  (Crypto only)
+  */
   { "crypt_opportunistic_encrypt", DT_BOOL, R_NONE, OPTCRYPTOPPORTUNISTICENCRYPT, 0 },
   /*
   ** .pp
@@ -1402,6 +1414,17 @@ struct option_t MuttVars[] = {
   ** This variable configures how often (in seconds) mutt should look for
   ** new mail. Also see the $$timeout variable.
   */
+#ifdef USE_INOTIFY
+  { "mail_check_watched", DT_NUM, R_NONE, UL &BuffyWatchedTimeout, 300 },
+  /*
+  ** .pp
+  ** Local mailboxes and the open folder are watched for changes, and are
+  ** only looked at when something has happened to them.  Some filesystems
+  ** (e.g. NFS or FUSE mounts) don't report changes made by other machines,
+  ** so this variable configures how often (in seconds) mutt should look at
+  ** the watched mailboxes anyway.  When set to 0, it never does.
+  */
+#endif
   { "mail_check_recent",DT_BOOL, R_NONE, OPTMAILCHECKRECENT, 1 },
   /*
   ** .pp
@@ -1537,6 +1560,10 @@ struct option_t MuttVars[] = {
   ** remote message only once and can perform regular expression searches
   ** as fast as for local folders.
   ** .pp
+  ** The \fC<fetch-mail>\fP function takes messages found here from the
+  ** cache instead of downloading them again, and notes which messages it
+  ** has delivered, so that an interrupted run doesn't deliver them twice.
+  ** .pp
   ** Also see the $$message_cache_clean variable.
   */
 #endif
@@ -1670,6 +1697,17 @@ struct option_t MuttVars[] = {
    */
 #endif
 #ifdef USE_NOTMUCH
+  { "nm_index_headers", DT_BOOL, R_NONE, OPTNOTMUCHINDEXHEADERS, 0 },
+  /*
+   ** .pp
+   ** When set, messages in virtual folders are set up from the header cache
+   ** of the maildir they are in, or else from the sender, subject and date
+   ** which notmuch keeps in its index, instead of parsing every message file.
+   ** The rest of the header and the MIME structure of such a message are read
+   ** when it is opened, so until then patterns on other header fields don't
+   ** match it, and threads of a ``messages'' query are only grouped by
+   ** subject.
+   */
   { "nm_open_timeout", DT_NUM, R_NONE, UL &NotmuchOpenTimeout, 5 },
   /*
    ** .pp
@@ -3170,6 +3208,15 @@ struct option_t MuttVars[] = {
   ** fairly secure machine, because the superuser can read your muttrc even
   ** if you are the only one who can read the file.
   */
+  { "smtp_reuse_connection", DT_BOOL, R_NONE, OPTSMTPREUSE, 0 },
+  /*
+  ** .pp
+  ** When set, Mutt keeps the connection to the SMTP server open after
+  ** sending a message and uses it for the next one, instead of connecting
+  ** and authenticating again.  This speeds up sending several messages in
+  ** a row, e.g. bouncing tagged messages.  The connection is closed when
+  ** Mutt exits.
+  */
   { "smtp_url",		DT_STR, R_NONE, UL &SmtpUrl, UL 0 },
   /*
   ** .pp
@@ -421,7 +421,7 @@ int km_dokey (int menu)
   struct keymap_t *map = Keymaps[menu];
   int pos = 0;
   int n = 0;
-  int i;
+  int i, expire;
 
   if (!map)
     return (retry_generic (menu, NULL, 0, 0));
@@ -429,6 +429,10 @@ int km_dokey (int menu)
   FOREVER
   {
     i = Timeout > 0 ? Timeout : 60;
+    /* decrypted messages have to be wiped on time even when idle */
+    if ((expire = crypt_expire_decrypted ()) > 0 && expire < i)
+      i = expire;
+
 #ifdef USE_IMAP
     /* keepalive may need to run more frequently than Timeout allows */
     if (ImapKeepalive)
@@ -438,9 +442,9 @@ int km_dokey (int menu)
       else
 	while (ImapKeepalive && ImapKeepalive < i)
 	{
-	  timeout (ImapKeepalive * 1000);
+	  mutt_getch_timeout (ImapKeepalive * 1000);
 	  tmp = mutt_getch ();
-	  timeout (-1);
+	  mutt_getch_timeout (-1);
 	  /* If a timeout was not received, or the window was resized, exit the
 	   * loop now.  Otherwise, continue to loop until reaching a total of
 	   * $timeout seconds.
@@ -456,9 +460,9 @@ int km_dokey (int menu)
     /* update sidebar stats */
     mutt_buffy_check(0);
 
-    timeout (i * 1000);
+    mutt_getch_timeout (i * 1000);
     tmp = mutt_getch();
-    timeout (-1);
+    mutt_getch_timeout (-1);
 
     /* hide timeouts from line editor */
     if (menu == MENU_EDITOR && tmp.ch == -2)
@@ -1111,6 +1111,9 @@ int main (int argc, char **argv)
     }
 
     rv = ci_send_message (sendflags, msg, bodyfile, NULL, NULL);
+#ifdef USE_SMTP
+    mutt_smtp_close ();
+#endif
 
     if (edit_infile)
     {
@@ -1247,9 +1250,14 @@ int main (int argc, char **argv)
 #ifdef USE_IMAP
     imap_logout_all ();
 #endif
+#ifdef USE_SMTP
+    mutt_smtp_close ();
+#endif
 #ifdef USE_SASL
     mutt_sasl_done ();
 #endif
+    if (WithCrypto)
+      crypt_forget_decrypted ();
     mutt_free_opts ();
     mutt_endwin (Errorbuf);
   }
@@ -49,6 +49,9 @@ void mutt_set_charset (char *charset)
 
   mutt_canonical_charset (buffer, sizeof (buffer), charset);
 
+  /* compiled format strings carry character widths */
+  mutt_format_cache_flush ();
+
   Charset_is_utf8 = 0;
 #ifndef HAVE_WC_FUNCS
   charset_is_ja = 0;
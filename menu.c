@@ -36,20 +36,25 @@ char* SearchBuffers[MENU_MAX];
 static int
 get_color (int index, unsigned char *s)
 {
-	COLOR_LINE *color;
 	HEADER *hdr = Context->hdrs[Context->v2r[index]];
 	int type = *s;
+#ifdef USE_NOTMUCH
+	COLOR_LINE *color;
+#endif
 
 	switch (type) {
 		case MT_COLOR_INDEX_AUTHOR:
-			color = ColorIndexAuthorList;
-			break;
 		case MT_COLOR_INDEX_FLAGS:
-			color = ColorIndexFlagsList;
-			break;
 		case MT_COLOR_INDEX_SUBJECT:
-			color = ColorIndexSubjectList;
-			break;
+			/* evaluated along with the index color, see
+			 * mutt_set_header_color() */
+			if (!hdr->color_valid)
+				mutt_set_header_color (Context, hdr);
+			if (type == MT_COLOR_INDEX_AUTHOR)
+				return hdr->author_pair;
+			if (type == MT_COLOR_INDEX_FLAGS)
+				return hdr->flags_pair;
+			return hdr->subject_pair;
 #ifdef USE_NOTMUCH
                 case MT_COLOR_INDEX_TAG:
                         for (color = ColorIndexTagList; color; color = color->next)
@@ -64,13 +69,6 @@ get_color (int index, unsigned char *s)
 		default:
 			return ColorDefs[type];
 	}
-
-	for (; color; color = color->next)
-		if (mutt_pattern_exec (color->color_pattern, M_MATCH_FULL_ADDRESS,
-		    Context, hdr))
-			return color->pair;
-
-	return 0;
 }
 
 static void print_enriched_string (int index, int attr, unsigned char *s, int do_color)
@@ -211,10 +209,12 @@ static void print_enriched_string (int index, int attr, unsigned char *s, int do
         if (*s == MT_COLOR_INDEX) {
           attrset (attr);
 	} else {
-          if (get_color (index, s) == 0) {
+          int color = get_color (index, s);
+
+          if (color == 0) {
             attron (attr);
 	  } else {
-            attron (get_color (index, s));
+            attron (color);
 	  }
         }
       }
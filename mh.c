@@ -923,7 +923,7 @@ static int maildir_move_to_context (CONTEXT * ctx, struct maildir **md)
 }
 
 #if USE_HCACHE
-static size_t maildir_hcache_keylen (const char *fn)
+size_t maildir_hcache_keylen (const char *fn)
 {
   const char * p = strrchr (fn, ':');
   return p ? (size_t) (p - fn) : mutt_strlen(fn);
@@ -1212,8 +1212,43 @@ static void maildir_delayed_parsing (CONTEXT * ctx, struct maildir **md,
   mh_sort_natural (ctx, md);
 }
 
+#if USE_HCACHE
+/* Save the attachment counts worked out since the mailbox was opened
+ * (for %X or ~X), so that they needn't be recomputed from the message
+ * files next time. Headers with unsynced changes are left alone. */
+static void mh_store_attach_counts (CONTEXT *ctx)
+{
+  header_cache_t *hc = NULL;
+  HEADER *h;
+  int i;
+
+  for (i = 0; i < ctx->msgcount; i++)
+  {
+    h = ctx->hdrs[i];
+    if (!h || !h->attach_dirty || h->changed || h->deleted || !h->path)
+      continue;
+
+    if (!hc && !(hc = mutt_hcache_open (HeaderCache, ctx->path, NULL)))
+      return;
+
+    if (ctx->magic == M_MAILDIR)
+      mutt_hcache_store (hc, h->path + 3, h, 0, &maildir_hcache_keylen, M_GENERATE_UIDVALIDITY);
+    else
+      mutt_hcache_store (hc, h->path, h, 0, strlen, M_GENERATE_UIDVALIDITY);
+    h->attach_dirty = 0;
+  }
+
+  if (hc)
+    mutt_hcache_close (hc);
+}
+#endif
+
 static int mh_close_mailbox (CONTEXT *ctx)
 {
+#if USE_HCACHE
+  mh_store_attach_counts (ctx);
+#endif
+
   FREE (&ctx->data);
 
   return 0;
@@ -0,0 +1,308 @@
+/*
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ * 
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ * 
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * The local mailboxes (and the open folder) are watched with inotify, so
+ * that buffy and mx_check_mailbox() only have to look at the ones something
+ * has happened to, and so that mutt_getch() can wake up on new mail.
+ *
+ * A mailbox is "clean" while all of its watches are in place and no event
+ * has been seen for them since it was last checked; anything else (no
+ * watch, a watch that went away, a failed inotify_init) makes the callers
+ * fall back to checking it as before.  As changes made over NFS and the
+ * like don't cause events, all mailboxes are also marked as changed every
+ * $mail_check_watched seconds.
+ */
+
+#if HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "mutt.h"
+#include "mx.h"
+#include "monitor.h"
+
+#include <sys/inotify.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MONITOR_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | \
+			IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+			IN_DELETE_SELF | IN_MOVE_SELF)
+
+static int MonitorFd = -1;
+static short MonitorFailed = 0;
+static time_t MonitorCheckTime = 0;	/* last time everything was looked at */
+
+/* the open folder, which need not be one of the mailboxes */
+static BUFFY MonitorContext;
+
+static int monitor_init (void)
+{
+  if (MonitorFd < 0 && !MonitorFailed)
+  {
+    if ((MonitorFd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC)) < 0)
+    {
+      dprint (1, (debugfile, "monitor: inotify_init1: %s\n", strerror (errno)));
+      MonitorFailed = 1;
+    }
+  }
+  return MonitorFd;
+}
+
+/* returns the inotify descriptor, or -1 if nothing is being watched */
+int mutt_monitor_fd (void)
+{
+  return MonitorFd;
+}
+
+static int monitor_watched (BUFFY *b)
+{
+  return b->monitor_wd[0] && (b->magic != M_MAILDIR || b->monitor_wd[1]);
+}
+
+static int monitor_watch (const char *path, const char *subdir)
+{
+  char buf[_POSIX_PATH_MAX];
+  int wd;
+
+  if (subdir)
+  {
+    snprintf (buf, sizeof (buf), "%s/%s", path, subdir);
+    path = buf;
+  }
+
+  if ((wd = inotify_add_watch (MonitorFd, path, MONITOR_EVENTS)) < 0)
+  {
+    dprint (2, (debugfile, "monitor: can't watch %s: %s\n", path, strerror (errno)));
+    return 0;
+  }
+  dprint (3, (debugfile, "monitor: watching %s [wd=%d]\n", path, wd));
+  return wd;
+}
+
+/* calls fn for every mailbox which has got the watch wd; the same file
+ * watched twice gets the same descriptor from inotify */
+static void monitor_foreach (int wd, void (*fn) (BUFFY *, int))
+{
+  BUFFY *b;
+
+  for (b = Incoming; b; b = b->next)
+    if (b->monitor_wd[0] == wd || b->monitor_wd[1] == wd)
+      fn (b, wd);
+  if (MonitorContext.monitor_wd[0] == wd || MonitorContext.monitor_wd[1] == wd)
+    fn (&MonitorContext, wd);
+}
+
+static int monitor_wd_used (BUFFY *except, int wd)
+{
+  BUFFY *b;
+
+  for (b = Incoming; b; b = b->next)
+    if (b != except && (b->monitor_wd[0] == wd || b->monitor_wd[1] == wd))
+      return 1;
+  return &MonitorContext != except &&
+	 (MonitorContext.monitor_wd[0] == wd || MonitorContext.monitor_wd[1] == wd);
+}
+
+static void monitor_set_changed (BUFFY *b, int wd)
+{
+  b->monitor_changed = 1;
+}
+
+static void monitor_set_all_changed (void)
+{
+  BUFFY *b;
+
+  for (b = Incoming; b; b = b->next)
+    b->monitor_changed = 1;
+  MonitorContext.monitor_changed = 1;
+}
+
+static void monitor_forget_wd (BUFFY *b, int wd)
+{
+  b->monitor_changed = 1;
+  if (b->monitor_wd[0] == wd)
+    b->monitor_wd[0] = 0;
+  if (b->monitor_wd[1] == wd)
+    b->monitor_wd[1] = 0;
+}
+
+/*
+ * Starts watching a local mailbox, if it isn't watched already, and marks
+ * it as clean.  To not miss anything, this has to be called before the
+ * mailbox is looked at.  Returns 0 if the mailbox is watched.
+ */
+int mutt_monitor_add (BUFFY *b)
+{
+  if (monitor_watched (b))
+  {
+    b->monitor_changed = 0;
+    return 0;
+  }
+
+  mutt_monitor_remove (b);
+  if (monitor_init () < 0)
+    return -1;
+
+  switch (b->magic)
+  {
+    case M_MAILDIR:
+      b->monitor_wd[0] = monitor_watch (b->path, "new");
+      b->monitor_wd[1] = monitor_watch (b->path, "cur");
+      break;
+    case M_MBOX:
+    case M_MMDF:
+    case M_MH:
+      b->monitor_wd[0] = monitor_watch (b->path, NULL);
+      break;
+    default:
+      return -1;
+  }
+
+  if (!monitor_watched (b))
+  {
+    mutt_monitor_remove (b);
+    return -1;
+  }
+  return 0;
+}
+
+void mutt_monitor_remove (BUFFY *b)
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+  {
+    if (b->monitor_wd[i] && !monitor_wd_used (b, b->monitor_wd[i]))
+      inotify_rm_watch (MonitorFd, b->monitor_wd[i]);
+    b->monitor_wd[i] = 0;
+  }
+  b->monitor_changed = 0;
+}
+
+/* the mailbox is watched and nothing has happened to it since last checked */
+int mutt_monitor_is_clean (BUFFY *b)
+{
+  return monitor_watched (b) && !b->monitor_changed;
+}
+
+/*
+ * Reads the pending events and marks the mailboxes they are for as changed.
+ * Returns 1 if any watched mailbox has changed since it was last checked.
+ */
+int mutt_monitor_poll (void)
+{
+  union
+  {
+    struct inotify_event ev;
+    char buf[4096];
+  } u;
+  struct inotify_event *ev;
+  ssize_t len;
+  char *p;
+  BUFFY *b;
+
+  if (MonitorFd < 0)
+    return 0;
+
+  /* changes made elsewhere don't cause events on all filesystems */
+  if (BuffyWatchedTimeout > 0 && time (NULL) - MonitorCheckTime >= BuffyWatchedTimeout)
+  {
+    monitor_set_all_changed ();
+    MonitorCheckTime = time (NULL);
+  }
+
+  while ((len = read (MonitorFd, u.buf, sizeof (u.buf))) > 0)
+  {
+    for (p = u.buf; p < u.buf + len; p += sizeof (struct inotify_event) + ev->len)
+    {
+      ev = (struct inotify_event *) p;
+
+      if (ev->mask & IN_MOVE_SELF)
+      {
+	/* the watch would follow the file to its new name */
+	inotify_rm_watch (MonitorFd, ev->wd);
+	monitor_foreach (ev->wd, monitor_forget_wd);
+      }
+      else if (ev->mask & IN_IGNORED)
+	monitor_foreach (ev->wd, monitor_forget_wd);
+      else if (ev->mask & IN_Q_OVERFLOW)
+	/* events were dropped, so anything may have changed */
+	monitor_set_all_changed ();
+      else if (ev->wd > 0)
+	monitor_foreach (ev->wd, monitor_set_changed);
+    }
+  }
+
+  for (b = Incoming; b; b = b->next)
+    if (b->monitor_changed)
+      return 1;
+  return MonitorContext.monitor_changed;
+}
+
+/*
+ * Marks all mailboxes as changed, for when something that decides whether
+ * they have new mail has changed without any event.
+ */
+void mutt_monitor_changed (void)
+{
+  monitor_set_all_changed ();
+}
+
+/* watches the open folder */
+static void monitor_context (CONTEXT *ctx)
+{
+  mutt_monitor_remove (&MonitorContext);
+  strfcpy (MonitorContext.path, ctx->path, sizeof (MonitorContext.path));
+  MonitorContext.magic = ctx->magic;
+  mutt_monitor_add (&MonitorContext);
+}
+
+void mutt_monitor_unwatch_context (CONTEXT *ctx)
+{
+  if (ctx == Context && ctx->path && mutt_strcmp (ctx->path, MonitorContext.path) == 0)
+  {
+    mutt_monitor_remove (&MonitorContext);
+    MonitorContext.path[0] = 0;
+  }
+}
+
+/*
+ * Returns 0 if the open folder can't have changed since this was called
+ * last, otherwise 1; the folder is marked clean for the next call.  Only
+ * Context is watched, so that opening another mailbox on the side (e.g.
+ * $postponed) doesn't take the watch away from it.
+ */
+int mutt_monitor_context_changed (CONTEXT *ctx)
+{
+  mutt_monitor_poll ();
+
+  if (!ctx->path || mutt_strcmp (ctx->path, MonitorContext.path) != 0 ||
+      MonitorContext.magic != ctx->magic)
+  {
+    /* start watching it now, the caller is about to look at it */
+    if (ctx == Context)
+      monitor_context (ctx);
+    return 1;
+  }
+
+  if (mutt_monitor_is_clean (&MonitorContext))
+    return 0;
+  mutt_monitor_add (&MonitorContext);
+  return 1;
+}
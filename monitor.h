@@ -0,0 +1,35 @@
+/*
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ * 
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ * 
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program; if not, write to the Free Software
+ *     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _MONITOR_H
+#define _MONITOR_H
+
+#include "buffy.h"
+
+/* watching local mailboxes for changes with inotify */
+
+int mutt_monitor_fd (void);
+int mutt_monitor_poll (void);
+
+int mutt_monitor_add (BUFFY *b);
+void mutt_monitor_remove (BUFFY *b);
+int mutt_monitor_is_clean (BUFFY *b);
+void mutt_monitor_changed (void);
+
+void mutt_monitor_unwatch_context (CONTEXT *ctx);
+int mutt_monitor_context_changed (CONTEXT *ctx);
+
+#endif /* _MONITOR_H */
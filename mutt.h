@@ -460,6 +460,9 @@ enum
 #endif
   OPTSIGDASHES,
   OPTSIGONTOP,
+#ifdef USE_SMTP
+  OPTSMTPREUSE,
+#endif
   OPTSORTRE,
   OPTSPAMSEP,
   OPTSTATUSONTOP,
@@ -554,6 +557,7 @@ enum
 #ifdef USE_NOTMUCH
   OPTVIRTSPOOLFILE,
   OPTNOTMUCHRECORD,
+  OPTNOTMUCHINDEXHEADERS,
 #endif
 
   OPTMAX
@@ -784,6 +788,10 @@ typedef struct header
 
   /* tells whether the attachment count is valid */
   unsigned int attach_valid : 1;
+  unsigned int attach_dirty : 1; /* attach_total is not in the header cache yet */
+
+  /* tells whether the cached index colors (pair, *_pair) are valid */
+  unsigned int color_valid : 1;
 
   /* the following are used to support collapsing threads  */
   unsigned int collapsed : 1; 	/* is this message part of a collapsed thread? */
@@ -793,6 +801,16 @@ typedef struct header
   short recipient;		/* user_is_recipient()'s return value, cached */
   
   int pair; 			/* color-pair to use when displaying in the index */
+  int author_pair;		/* color of the author field, 0 for none */
+  int flags_pair;		/* color of the flags field, 0 for none */
+  int subject_pair;		/* color of the subject field, 0 for none */
+
+  /* cached $index_format rendering, valid while index_line_gen matches
+   * IndexLineGen and the format flags and screen width are unchanged */
+  char *index_line;
+  unsigned int index_line_gen;
+  int index_line_flags;
+  int index_line_cols;
 
   time_t date_sent;     	/* time when the message was sent (UTC) */
   time_t received;      	/* time when the message was placed in the mailbox */
@@ -809,8 +827,10 @@ typedef struct header
   char *tree;           	/* character string to print thread tree */
   THREAD *thread;
 
-  /* Number of qualifying attachments in message, if attach_valid */
+  /* Number of qualifying attachments in message, if attach_valid and
+   * attach_stamp matches AttachStamp */
   short attach_total;
+  unsigned int attach_stamp;
 
 #ifdef MIXMASTER
   LIST *chain;
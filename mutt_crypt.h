@@ -157,6 +157,28 @@ void crypt_opportunistic_encrypt(HEADER *msg);
 /* Forget a passphrase and display a message. */
 void crypt_forget_passphrase (void);
 
+/* Forget the results of earlier signature checks, e.g. because the
+   keyring has changed. */
+void crypt_forget_signatures (void);
+
+/* The latest modification time of the files of the PGP or S/MIME
+   keyring which command uses, see crypt.c. */
+time_t crypt_keyring_stamp (int smime, const char *command);
+
+/* Reuse the output of an earlier decryption of the LENGTH bytes at
+   OFFSET in FPIN, see crypt.c.  */
+int crypt_decrypted_lookup (FILE *fpin, LOFF_T offset, LOFF_T length, int smime,
+			    unsigned char *digest, FILE *fpout, FILE *fperr,
+			    int *rc);
+void crypt_decrypted_store (const unsigned char *digest, int smime,
+			    FILE *fpout, LOFF_T outpos, FILE *fperr, int rc);
+
+/* Wipe the decryption results kept in memory. */
+void crypt_forget_decrypted (void);
+
+/* Wipe the ones whose time is up, see crypt.c. */
+int crypt_expire_decrypted (void);
+
 /* Check that we have a usable passphrase, ask if not. */
 int crypt_valid_passphrase (int);
 
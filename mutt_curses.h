@@ -91,6 +91,7 @@ void mutt_curs_set (int);
 #endif
 
 event_t mutt_getch (void);
+void mutt_getch_timeout (int);
 
 void mutt_endwin (const char *);
 void mutt_flushinp (void);
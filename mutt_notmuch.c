@@ -21,6 +21,7 @@
 
 #include "mutt.h"
 #include "mx.h"
+#include "mime.h"
 #include "rfc2047.h"
 #include "sort.h"
 #include "mailbox.h"
@@ -44,6 +45,11 @@
 
 #include "mutt_notmuch.h"
 #include "mutt_curses.h"
+#include "mutt_crypt.h"
+
+#if USE_HCACHE
+#include "hcache.h"
+#endif
 
 #ifdef LIBNOTMUCH_CHECK_VERSION
 #undef LIBNOTMUCH_CHECK_VERSION
@@ -57,6 +63,9 @@
       LIBNOTMUCH_MICRO_VERSION >= (micro)))
 
 
+/* messages modified within one transaction by bulk operations */
+#define NM_TRANS_MAX	1000
+
 /* read whole-thread or matching messages only? */
 enum {
 	NM_QUERY_TYPE_MESGS = 1,	/* default */
@@ -93,8 +102,13 @@ struct nm_hdrdata {
 	char *oldpath;
 	char *virtual_id;
 	int magic;
+	int partial;		/* set up from the notmuch index only */
 };
 
+#if USE_HCACHE
+#define NM_HCACHE_MAX	8	/* header caches kept open while reading */
+#endif
+
 /*
  * CONTEXT->data
  */
@@ -108,6 +122,9 @@ struct nm_ctxdata {
 
 	struct uri_tag *query_items;
 
+	unsigned long revision;	/* of the database when last read */
+	char *db_uuid;
+
 	progress_t progress;
 	int oldmsgcount;
 	int ignmsgcount;	/* ingored messages */
@@ -117,9 +134,37 @@ struct nm_ctxdata {
 		     trans : 1,
 		     progress_ready : 1;
 
+#if USE_HCACHE
+	struct {
+		char *folder;
+		header_cache_t *hc;
+	} hcache[NM_HCACHE_MAX];
+	int hcache_next;
+#endif
+};
+
+/*
+ * counts of a virtual mailbox, valid as long as the database is not modified
+ */
+struct nm_count {
+	char *key;		/* URI, unread and exclude tags */
+	time_t checked;		/* when counted */
+	int all;
+	int new;
+
+	struct nm_count *next;
 };
 
+static struct nm_count *CountCache;
+
+/* read-only DB shared by all counts of one buffy check */
+static notmuch_database_t *CountDb;
+static char *CountDbFilename;
+
 static HEADER *get_mutt_header(CONTEXT *ctx, notmuch_message_t *msg);
+#if USE_HCACHE
+static void release_hcache(struct nm_ctxdata *data);
+#endif
 static notmuch_message_t *get_nm_message(notmuch_database_t *db, HEADER *hdr);
 
 static void url_free_tags(struct uri_tag *tags)
@@ -248,9 +293,13 @@ static void free_ctxdata(struct nm_ctxdata *data)
 		notmuch_database_close(data->db);
 #endif
 	data->db = NULL;
+#if USE_HCACHE
+	release_hcache(data);
+#endif
 
 	FREE(&data->db_filename);
 	FREE(&data->db_query);
+	FREE(&data->db_uuid);
 	url_free_tags(data->query_items);
 	FREE(&data);
 }
@@ -371,6 +420,56 @@ char *nm_header_get_fullpath(HEADER *h, char *buf, size_t bufsz)
 }
 
 
+int nm_header_is_partial(HEADER *h)
+{
+	return h && h->data && ((struct nm_hdrdata *) h->data)->partial;
+}
+
+/*
+ * Reads the rest of a header which was set up from the notmuch index, once
+ * the message file is open.  Like imap_fetch_message(), the new envelope is
+ * merged into the old one, so that the fields mutt has already hashed or
+ * threaded on stay put.
+ */
+void nm_read_partial_header(HEADER *h, FILE *fp)
+{
+	ENVELOPE *newenv;
+	struct stat st;
+	int read, old, flagged, replied;
+
+	if (!nm_header_is_partial(h) || !fp)
+		return;
+
+	dprint(2, (debugfile, "nm: reading partial header %s\n", h->path));
+
+	/* the flags come from the maildir filename, not the Status header */
+	read = h->read;
+	old = h->old;
+	flagged = h->flagged;
+	replied = h->replied;
+
+	mutt_free_body(&h->content);
+	rewind(fp);
+	newenv = mutt_read_rfc822_header(fp, h, 0, 0);
+	mutt_merge_envelopes(h->env, &newenv);
+
+	h->read = read;
+	h->old = old;
+	h->flagged = flagged;
+	h->replied = replied;
+
+	if (fstat(fileno(fp), &st) == 0)
+		h->content->length = st.st_size - h->content->offset;
+
+	if (h->content->type == TYPEMULTIPART || h->content->type == TYPEMESSAGE)
+		mutt_parse_part(fp, h->content);
+	if (WithCrypto)
+		h->security = crypt_query(h->content);
+
+	((struct nm_hdrdata *) h->data)->partial = 0;
+	rewind(fp);
+}
+
 static struct nm_ctxdata *get_ctxdata(CONTEXT *ctx)
 {
 	if (ctx && ctx->magic == M_NOTMUCH)
@@ -597,15 +696,12 @@ void nm_debug_check(CONTEXT *ctx)
 	}
 }
 
-static int get_database_mtime(struct nm_ctxdata *data, time_t *mtime)
+static int get_filename_mtime(const char *filename, time_t *mtime)
 {
 	char path[_POSIX_PATH_MAX];
 	struct stat st;
 
-	if (!data)
-	       return -1;
-
-	snprintf(path, sizeof(path), "%s/.notmuch/xapian", get_db_filename(data));
+	snprintf(path, sizeof(path), "%s/.notmuch/xapian", filename);
 	dprint(2, (debugfile, "nm: checking '%s' mtime\n", path));
 
 	if (stat(path, &st))
@@ -617,6 +713,14 @@ static int get_database_mtime(struct nm_ctxdata *data, time_t *mtime)
 	return 0;
 }
 
+static int get_database_mtime(struct nm_ctxdata *data, time_t *mtime)
+{
+	if (!data)
+	       return -1;
+
+	return get_filename_mtime(get_db_filename(data), mtime);
+}
+
 static void apply_exclude_tags(notmuch_query_t *query)
 {
 	char *buf, *p, *end = NULL, *tag = NULL;
@@ -762,6 +866,8 @@ static int update_header_tags(HEADER *h, notmuch_message_t *msg)
 	data->tags_transformed = ttstr;
 	dprint(2, (debugfile, "nm: new tag transforms: '%s'\n", ttstr));
 
+	/* cached index lines may show the old tags (%g, %G) */
+	IndexLineGen++;
 	return 0;
 }
 
@@ -917,6 +1023,146 @@ static const char *get_message_last_filename(notmuch_message_t *msg)
 	return name;
 }
 
+/* converts a header field as notmuch stores it (UTF-8) to $charset */
+static char *nm_header_string(const char *str)
+{
+	char *s;
+
+	if (!str || !*str)
+		return NULL;
+
+	s = safe_strdup(str);
+	mutt_convert_string(&s, "utf-8", Charset, 0);
+	return s;
+}
+
+/*
+ * Sets up a header from the fields notmuch keeps in its index, without
+ * reading the message file.  As with the partial header FETCH in the IMAP
+ * code, the rest of the header and the MIME structure are read when the
+ * message is opened, see nm_read_partial_header().
+ */
+static HEADER *header_from_index(notmuch_message_t *msg,
+				 notmuch_message_t *parent,
+				 const char *path)
+{
+	HEADER *h;
+	struct stat st;
+	regmatch_t pmatch[1];
+	char *s;
+
+	if (stat(path, &st) != 0)
+		return NULL;
+
+	h = mutt_new_header();
+	h->env = mutt_new_envelope();
+
+	h->content = mutt_new_body();
+	h->content->type = TYPETEXT;
+	h->content->subtype = safe_strdup("plain");
+	h->content->encoding = ENC7BIT;
+	h->content->disposition = DISPINLINE;
+	h->content->length = st.st_size;
+
+	if ((s = nm_header_string(notmuch_message_get_header(msg, "from")))) {
+		h->env->from = rfc822_parse_adrlist(NULL, s);
+		FREE(&s);
+	}
+
+	h->env->subject = nm_header_string(notmuch_message_get_header(msg, "subject"));
+	if (h->env->subject) {
+		if (regexec(ReplyRegexp.rx, h->env->subject, 1, pmatch, 0) == 0)
+			h->env->real_subj = h->env->subject + pmatch[0].rm_eo;
+		else
+			h->env->real_subj = h->env->subject;
+	}
+
+	/* when reading threads we know what this is a reply to */
+	if (parent) {
+		h->env->in_reply_to = mutt_new_list();
+		h->env->in_reply_to->data =
+			nm2mutt_message_id(notmuch_message_get_message_id(parent));
+	}
+
+	h->date_sent = notmuch_message_get_date(msg);
+	h->received = h->date_sent;
+	h->index = -1;
+
+	maildir_parse_flags(h, path);
+	return h;
+}
+
+#if USE_HCACHE
+static header_cache_t *get_hcache(struct nm_ctxdata *data, const char *folder)
+{
+	int i;
+
+	for (i = 0; i < NM_HCACHE_MAX; i++)
+		if (data->hcache[i].folder
+		    && strcmp(data->hcache[i].folder, folder) == 0)
+			return data->hcache[i].hc;
+
+	i = data->hcache_next;
+	data->hcache_next = (i + 1) % NM_HCACHE_MAX;
+
+	if (data->hcache[i].hc)
+		mutt_hcache_close(data->hcache[i].hc);
+	FREE(&data->hcache[i].folder);
+
+	data->hcache[i].folder = safe_strdup(folder);
+	data->hcache[i].hc = mutt_hcache_open(HeaderCache, folder, NULL);
+	return data->hcache[i].hc;
+}
+
+static void release_hcache(struct nm_ctxdata *data)
+{
+	int i;
+
+	for (i = 0; i < NM_HCACHE_MAX; i++) {
+		if (data->hcache[i].hc)
+			mutt_hcache_close(data->hcache[i].hc);
+		data->hcache[i].hc = NULL;
+		FREE(&data->hcache[i].folder);
+	}
+	data->hcache_next = 0;
+}
+
+/* restores the header from the cache of the maildir the message is in */
+static HEADER *header_from_hcache(struct nm_ctxdata *data, const char *path)
+{
+	header_cache_t *hc;
+	struct stat st;
+	struct timeval *when;
+	char *folder;
+	const char *key;
+	void *hdata;
+	HEADER *h = NULL;
+
+	if (!HeaderCache || !(folder = get_folder_from_path(path)))
+		return NULL;
+
+	hc = get_hcache(data, folder);
+	FREE(&folder);
+	if (!hc || !(key = strrchr(path, '/')))
+		return NULL;
+
+	if ((hdata = mutt_hcache_fetch(hc, key, &maildir_hcache_keylen))) {
+		when = (struct timeval *) hdata;
+
+		if (!option(OPTHCACHEVERIFY) ||
+		    (stat(path, &st) == 0 && st.st_mtime <= when->tv_sec)) {
+			h = mutt_hcache_restore((unsigned char *) hdata, NULL);
+			h->data = NULL;
+			h->free_cb = NULL;
+			maildir_parse_flags(h, path);
+		}
+		FREE(&hdata);
+	}
+
+	return h;
+}
+#endif
+
 static void nm_progress_reset(CONTEXT *ctx)
 {
 	struct nm_ctxdata *data;
@@ -965,11 +1211,13 @@ static void nm_progress_update(CONTEXT *ctx, notmuch_query_t *q)
 static void append_message(CONTEXT *ctx,
 			   notmuch_query_t *q,
 			   notmuch_message_t *msg,
+			   notmuch_message_t *parent,
 			   int dedup)
 {
 	char *newpath = NULL;
 	const char *path;
 	HEADER *h = NULL;
+	int partial = 0;
 
 	/* deduplicate */
 	if (dedup && get_mutt_header(ctx, msg)) {
@@ -993,7 +1241,14 @@ static void append_message(CONTEXT *ctx,
 		dprint(2, (debugfile, "nm: allocate mx memory\n"));
 		mx_alloc_memory(ctx);
 	}
-	if (access(path, F_OK) == 0)
+	if (option(OPTNOTMUCHINDEXHEADERS) && access(path, F_OK) == 0) {
+#if USE_HCACHE
+		h = header_from_hcache(get_ctxdata(ctx), path);
+#endif
+		if (!h && (h = header_from_index(msg, parent, path)))
+			partial = 1;
+	}
+	else if (access(path, F_OK) == 0)
 		h = maildir_parse_message(M_MAILDIR, path, 0, NULL);
 	else {
 		/* maybe moved try find it... */
@@ -1021,6 +1276,7 @@ static void append_message(CONTEXT *ctx,
 		dprint(1, (debugfile, "nm: failed to append header!\n"));
 		goto done;
 	}
+	((struct nm_hdrdata *) h->data)->partial = partial;
 
 	h->active = 1;
 	h->index = ctx->msgcount;
@@ -1061,7 +1317,7 @@ static void append_replies(CONTEXT *ctx,
 	     notmuch_messages_move_to_next(msgs)) {
 
 		notmuch_message_t *m = notmuch_messages_get(msgs);
-		append_message(ctx, q, m, dedup);
+		append_message(ctx, q, m, top, dedup);
 		/* recurse through all the replies to this message too */
 		append_replies(ctx, q, m, dedup);
 		notmuch_message_destroy(m);
@@ -1084,7 +1340,7 @@ static void append_thread(CONTEXT *ctx,
 	     notmuch_messages_move_to_next(msgs)) {
 
 		notmuch_message_t *m = notmuch_messages_get(msgs);
-		append_message(ctx, q, m, dedup);
+		append_message(ctx, q, m, NULL, dedup);
 		append_replies(ctx, q, m, dedup);
 		notmuch_message_destroy(m);
 	}
@@ -1113,7 +1369,7 @@ static void read_mesgs_query(CONTEXT *ctx, notmuch_query_t *q, int dedup)
 	     notmuch_messages_move_to_next(msgs)) {
 
 		notmuch_message_t *m = notmuch_messages_get(msgs);
-		append_message(ctx, q, m, dedup);
+		append_message(ctx, q, m, NULL, dedup);
 		notmuch_message_destroy(m);
 	}
 }
@@ -1163,6 +1419,13 @@ int nm_read_query(CONTEXT *ctx)
 
 	q = get_query(data, FALSE);
 	if (q) {
+#if LIBNOTMUCH_CHECK_VERSION(4,3,0)
+		const char *uuid = NULL;
+
+		/* read before the messages, so later changes are never missed */
+		data->revision = notmuch_database_get_revision(get_db(data, FALSE), &uuid);
+		mutt_str_replace(&data->db_uuid, uuid);
+#endif
 		switch(get_query_type(data)) {
 		case NM_QUERY_TYPE_MESGS:
 			read_mesgs_query(ctx, q, 0);
@@ -1178,6 +1441,9 @@ int nm_read_query(CONTEXT *ctx)
 
 	if (!is_longrun(data))
 		release_db(data);
+#if USE_HCACHE
+	release_hcache(data);
+#endif
 
 	ctx->mtime = time(NULL);
 
@@ -1232,6 +1498,9 @@ done:
 		notmuch_query_destroy(q);
 	if (!is_longrun(data))
 		release_db(data);
+#if USE_HCACHE
+	release_hcache(data);
+#endif
 
 	if (ctx->msgcount == data->oldmsgcount)
 		mutt_message _("No more messages in the thread.");
@@ -1351,6 +1620,75 @@ done:
 	return rc;
 }
 
+/*
+ * Modifies the tags of all the tagged (and visible) messages, in large
+ * transactions rather than one by one.  The messages are also hidden if
+ * @hide is set.  Returns number of modified messages or -1 on error.
+ */
+int nm_modify_tagged_tags(CONTEXT *ctx, char *buf, int hide)
+{
+	struct nm_ctxdata *data = get_ctxdata(ctx);
+	notmuch_database_t *db = NULL;
+	char msgbuf[STRING];
+	progress_t progress;
+	int i, n = 0, longrun;
+
+	if (!buf || !*buf || !data)
+		return -1;
+
+	longrun = is_longrun(data);
+	if (!(db = get_db(data, TRUE)))
+		return -1;
+
+	dprint(1, (debugfile, "nm: tags modify tagged: '%s'\n", buf));
+
+	if (!ctx->quiet) {
+		snprintf(msgbuf, sizeof(msgbuf), _("Update labels..."));
+		mutt_progress_init(&progress, msgbuf, M_PROGRESS_MSG,
+				   1, ctx->tagged);
+	}
+
+	for (i = 0; i < ctx->vcount; i++) {
+		HEADER *hdr = ctx->hdrs[ctx->v2r[i]];
+		notmuch_message_t *msg;
+
+		if (!hdr->tagged)
+			continue;
+		if (!ctx->quiet)
+			mutt_progress_update(&progress, n + 1, -1);
+
+		/* commit now and then, the changes are kept in memory */
+		if (n % NM_TRANS_MAX == 0) {
+			db_trans_end(data);
+			if (db_trans_begin(data) < 0)
+				break;
+		}
+		n++;
+
+		if (hide) {
+			hdr->quasi_deleted = TRUE;
+			ctx->changed = TRUE;
+		}
+		if (!(msg = get_nm_message(db, hdr)))
+			continue;
+
+		update_tags(msg, buf);
+		update_header_tags(hdr, msg);
+		mutt_set_header_color(ctx, hdr);
+		hdr->changed = TRUE;
+
+		notmuch_message_destroy(msg);
+	}
+
+	db_trans_end(data);
+	if (!longrun)
+		release_db(data);
+	if (n)
+		ctx->mtime = time(NULL);
+	dprint(1, (debugfile, "nm: tags modify tagged done [count=%d]\n", n));
+	return n;
+}
+
 static int rename_maildir_filename(const char *old, char *newpath, size_t newsz, HEADER *h)
 {
 	char filename[_POSIX_PATH_MAX];
@@ -1560,7 +1898,7 @@ int nm_sync(CONTEXT *ctx, int *index_hint)
 	char msgbuf[STRING];
 	progress_t progress;
 	char *uri = ctx->path;
-	int changed = 0;
+	int changed = 0, renamed = 0;
 
 	if (!data)
 		return -1;
@@ -1574,6 +1912,10 @@ int nm_sync(CONTEXT *ctx, int *index_hint)
 				   WriteInc, ctx->msgcount);
 	}
 
+	/* rename the files within few large transactions */
+	if (get_db(data, TRUE))
+		db_trans_begin(data);
+
 	for (i = 0; i < ctx->msgcount; i++) {
 		char old[_POSIX_PATH_MAX], new[_POSIX_PATH_MAX];
 		HEADER *h = ctx->hdrs[i];
@@ -1612,6 +1954,9 @@ int nm_sync(CONTEXT *ctx, int *index_hint)
 				changed = 1;
 			else if (*new && *old && rename_filename(data, old, new, h) == 0)
 				changed = 1;
+
+			if (++renamed % NM_TRANS_MAX == 0 && db_trans_end(data) == 0)
+				db_trans_begin(data);
 		}
 
 		FREE(&hd->oldpath);
@@ -1619,6 +1964,7 @@ int nm_sync(CONTEXT *ctx, int *index_hint)
 
 	ctx->path = uri;
 	ctx->magic = M_NOTMUCH;
+	db_trans_end(data);
 
 	if (!is_longrun(data))
 		release_db(data);
@@ -1648,11 +1994,68 @@ static unsigned count_query(notmuch_database_t *db, const char *qstr)
 	return res;
 }
 
+static notmuch_database_t *get_count_db(const char *filename)
+{
+	if (CountDb && mutt_strcmp(filename, CountDbFilename) == 0)
+		return CountDb;
+
+	nm_nonctx_release_db();
+
+	/* don't be verbose about connection, as we're called from
+	 * sidebar/buffy very often */
+	CountDb = do_database_open(filename, FALSE, FALSE);
+	if (CountDb)
+		CountDbFilename = safe_strdup(filename);
+	return CountDb;
+}
+
+/*
+ * Closes the database opened to count virtual mailboxes; buffy keeps it open
+ * while it checks all the mailboxes.
+ */
+void nm_nonctx_release_db(void)
+{
+	if (!CountDb)
+		return;
+#ifdef NOTMUCH_API_3
+	notmuch_database_destroy(CountDb);
+#else
+	notmuch_database_close(CountDb);
+#endif
+	CountDb = NULL;
+	FREE(&CountDbFilename);
+	dprint(1, (debugfile, "nm: count close DB\n"));
+}
+
+static struct nm_count *get_count(const char *path)
+{
+	struct nm_count *c;
+	char *key = NULL;
+
+	safe_asprintf(&key, "%s\n%s\n%s", path,
+			NONULL(NotmuchUnreadTag), NONULL(NotmuchExcludeTags));
+
+	for (c = CountCache; c; c = c->next)
+		if (strcmp(c->key, key) == 0)
+			break;
+	if (c)
+		FREE(&key);
+	else {
+		c = safe_calloc(1, sizeof(struct nm_count));
+		c->key = key;
+		c->next = CountCache;
+		CountCache = c;
+	}
+	return c;
+}
+
 int nm_nonctx_get_count(char *path, int *all, int *new)
 {
 	struct uri_tag *query_items = NULL, *item;
+	struct nm_count *cnt;
 	char *db_filename = NULL, *db_query = NULL;
 	notmuch_database_t *db = NULL;
+	time_t mtime;
 	int rc = -1, dflt = 0;
 
 	dprint(1, (debugfile, "nm: count\n"));
@@ -1685,36 +2088,41 @@ int nm_nonctx_get_count(char *path, int *all, int *new)
 		dflt = 1;
 	}
 
-	/* don't be verbose about connection, as we're called from
-	 * sidebar/buffy very often */
-	db = do_database_open(db_filename, FALSE, FALSE);
+	/* the counts can't change as long as the database is not modified;
+	 * a change within the second it was counted in may have been missed */
+	cnt = get_count(path);
+	if (cnt->checked && get_filename_mtime(db_filename, &mtime) == 0
+	    && cnt->checked > mtime) {
+		dprint(2, (debugfile, "nm: count cached [all=%d, new=%d]\n",
+					cnt->all, cnt->new));
+		goto found;
+	}
+
+	db = get_count_db(db_filename);
 	if (!db)
 		goto done;
 
+	cnt->checked = time(NULL);
+
 	/* all emails */
-	if (all)
-		*all = count_query(db, db_query);
+	cnt->all = count_query(db, db_query);
 
 	/* new messages */
-	if (new) {
+	{
 		char *qstr;
 
 		safe_asprintf(&qstr, "( %s ) tag:%s",
 				db_query, NotmuchUnreadTag);
-		*new = count_query(db, qstr);
+		cnt->new = count_query(db, qstr);
 		FREE(&qstr);
 	}
-
+found:
+	if (all)
+		*all = cnt->all;
+	if (new)
+		*new = cnt->new;
 	rc = 0;
 done:
-	if (db) {
-#ifdef NOTMUCH_API_3
-		notmuch_database_destroy(db);
-#else
-		notmuch_database_close(db);
-#endif
-		dprint(1, (debugfile, "nm: count close DB\n"));
-	}
 	if (!dflt)
 		FREE(&db_filename);
 	url_free_tags(query_items);
@@ -1784,13 +2192,140 @@ static HEADER *get_mutt_header(CONTEXT *ctx, notmuch_message_t *msg)
 	return h;
 }
 
+/* merges a message found by a database check into the context */
+static void merge_message(CONTEXT *ctx, notmuch_message_t *m, int *new_flags)
+{
+	char old[_POSIX_PATH_MAX];
+	const char *new;
+	HEADER *h = get_mutt_header(ctx, m);
+
+	if (!h) {
+		/* new email */
+		append_message(ctx, NULL, m, NULL, 0);
+		return;
+	}
+
+	/* message already exists, merge flags */
+	h->active = 1;
+
+	/* check to see if the message has moved to a different
+	 * subdirectory.  If so, update the associated filename.
+	 */
+	new = get_message_last_filename(m);
+	nm_header_get_fullpath(h, old, sizeof(old));
+
+	if (mutt_strcmp(old, new) != 0)
+		update_message_path(h, new);
+
+	if (!h->changed) {
+		/* if the user hasn't modified the flags on
+		 * this message, update the flags we just
+		 * detected.
+		 */
+		HEADER tmp;
+		memset(&tmp, 0, sizeof(tmp));
+		maildir_parse_flags(&tmp, new);
+		maildir_update_flags(ctx, h, &tmp);
+	}
+
+	if (update_header_tags(h, m) == 0)
+		(*new_flags)++;
+}
+
+#if LIBNOTMUCH_CHECK_VERSION(4,3,0)
+/*
+ * Merges only the messages changed since the database revision we last read
+ * (notmuch "lastmod:" queries) into the context; those changed so as to no
+ * longer match the query are marked inactive.  Returns 0 on success, or -1
+ * if the whole query has to be read again, e.g. because messages have been
+ * removed from the database, which lastmod: can't tell.
+ */
+static int read_changed_mesgs(CONTEXT *ctx, int *new_flags)
+{
+	struct nm_ctxdata *data = get_ctxdata(ctx);
+	notmuch_database_t *db;
+	notmuch_query_t *q;
+	notmuch_messages_t *msgs;
+	const char *str;
+	char *qstr = NULL;
+	char rev[STRING];
+	unsigned count;
+	int i, active, gone;
+
+	if (!data->revision || get_limit(data) ||
+	    get_query_type(data) != NM_QUERY_TYPE_MESGS)
+		return -1;
+	if (!(db = get_db(data, FALSE)) || !(str = get_query_string(data)))
+		return -1;
+
+	snprintf(rev, sizeof(rev), "lastmod:%lu..", data->revision + 1);
+
+	for (gone = 0; gone < 2; gone++) {
+		append_str_item(&qstr, gone ? "not (" : "(", 0);
+		append_str_item(&qstr, str, 0);
+		append_str_item(&qstr, ") and ", 0);
+		append_str_item(&qstr, rev, 0);
+
+		dprint(2, (debugfile, "nm: changes query '%s'\n", qstr));
+
+		q = notmuch_query_create(db, qstr);
+		FREE(&qstr);
+		if (!q)
+			return -1;
+		if (!gone)
+			apply_exclude_tags(q);
+
+		if (notmuch_query_search_messages_st(q, &msgs) != NOTMUCH_STATUS_SUCCESS) {
+			notmuch_query_destroy(q);
+			return -1;
+		}
+
+		for (; notmuch_messages_valid(msgs);
+		     notmuch_messages_move_to_next(msgs)) {
+
+			notmuch_message_t *m = notmuch_messages_get(msgs);
+
+			if (!gone)
+				merge_message(ctx, m, new_flags);
+			else {
+				HEADER *h = get_mutt_header(ctx, m);
+				if (h)
+					h->active = 0;
+			}
+			notmuch_message_destroy(m);
+		}
+		notmuch_query_destroy(q);
+	}
+
+	/* the context has to hold exactly what the query matches now */
+	if (!(q = get_query(data, FALSE)))
+		return -1;
+	if (notmuch_query_count_messages_st(q, &count) != NOTMUCH_STATUS_SUCCESS)
+		count = 0;
+	notmuch_query_destroy(q);
+
+	for (i = 0, active = 0; i < ctx->msgcount; i++)
+		if (ctx->hdrs[i]->active)
+			active++;
+
+	dprint(2, (debugfile, "nm: changes merged (query=%u context=%d)\n",
+				count, active));
+	return count == (unsigned) active ? 0 : -1;
+}
+#endif
+
 int nm_check_database(CONTEXT *ctx, int *index_hint)
 {
 	struct nm_ctxdata *data = get_ctxdata(ctx);
 	time_t mtime = 0;
-	notmuch_query_t *q;
+	notmuch_query_t *q = NULL;
 	notmuch_messages_t *msgs;
 	int i, limit, occult = 0, new_flags = 0;
+#if LIBNOTMUCH_CHECK_VERSION(4,3,0)
+	notmuch_database_t *db;
+	const char *uuid = NULL;
+	unsigned long rev = 0;
+#endif
 
 	if (!data || get_database_mtime(data, &mtime) != 0)
 		return -1;
@@ -1802,13 +2337,28 @@ int nm_check_database(CONTEXT *ctx, int *index_hint)
 
 	dprint(1, (debugfile, "nm: checking (db=%d ctx=%d)\n", mtime, ctx->mtime));
 
+	data->oldmsgcount = ctx->msgcount;
+	data->noprogress = 1;
+
+#if LIBNOTMUCH_CHECK_VERSION(4,3,0)
+	if (!(db = get_db(data, FALSE)))
+		goto done;
+
+	/* a different or rebuilt database has revisions of its own */
+	rev = notmuch_database_get_revision(db, &uuid);
+	if (mutt_strcmp(uuid, data->db_uuid) != 0)
+		data->revision = 0;
+
+	if (read_changed_mesgs(ctx, &new_flags) == 0)
+		goto merged;
+	new_flags = 0;
+#endif
+
 	q = get_query(data, FALSE);
 	if (!q)
 		goto done;
 
 	dprint(1, (debugfile, "nm: start checking (count=%d)\n", ctx->msgcount));
-	data->oldmsgcount = ctx->msgcount;
-	data->noprogress = 1;
 
 	for (i = 0; i < ctx->msgcount; i++)
 		ctx->hdrs[i]->active = 0;
@@ -1826,48 +2376,16 @@ int nm_check_database(CONTEXT *ctx, int *index_hint)
 	     notmuch_messages_valid(msgs) && (limit == 0 || i < limit);
 	     notmuch_messages_move_to_next(msgs), i++) {
 
-		char old[_POSIX_PATH_MAX];
-		const char *new;
-
 		notmuch_message_t *m = notmuch_messages_get(msgs);
-		HEADER *h = get_mutt_header(ctx, m);
-
-		if (!h) {
-			/* new email */
-			append_message(ctx, NULL, m, 0);
-			notmuch_message_destroy(m);
-			continue;
-		}
-
-		/* message already exists, merge flags */
-		h->active = 1;
-
-		/* check to see if the message has moved to a different
-		 * subdirectory.  If so, update the associated filename.
-		 */
-		new = get_message_last_filename(m);
-		nm_header_get_fullpath(h, old, sizeof(old));
-
-		if (mutt_strcmp(old, new) != 0)
-			update_message_path(h, new);
-
-		if (!h->changed) {
-			/* if the user hasn't modified the flags on
-			 * this message, update the flags we just
-			 * detected.
-			 */
-			HEADER tmp;
-			memset(&tmp, 0, sizeof(tmp));
-			maildir_parse_flags(&tmp, new);
-			maildir_update_flags(ctx, h, &tmp);
-		}
-
-		if (update_header_tags(h, m) == 0)
-			new_flags++;
-
+		merge_message(ctx, m, &new_flags);
 		notmuch_message_destroy(m);
 	}
 
+#if LIBNOTMUCH_CHECK_VERSION(4,3,0)
+merged:
+	data->revision = rev;
+	mutt_str_replace(&data->db_uuid, uuid);
+#endif
 	for (i = 0; i < ctx->msgcount; i++) {
 		if (ctx->hdrs[i]->active == 0) {
 			occult = 1;
@@ -1883,6 +2401,9 @@ done:
 
 	if (!is_longrun(data))
 		release_db(data);
+#if USE_HCACHE
+	release_hcache(data);
+#endif
 
 	ctx->mtime = time(NULL);
 
@@ -12,9 +12,12 @@ int nm_check_database(CONTEXT * ctx, int *index_hint);
 char *nm_header_get_folder(HEADER *h);
 int nm_header_get_magic(HEADER *h);
 char *nm_header_get_fullpath(HEADER *h, char *buf, size_t bufsz);
+int nm_header_is_partial(HEADER *h);
+void nm_read_partial_header(HEADER *h, FILE *fp);
 int nm_update_filename(CONTEXT *ctx, const char *o, const char *n, HEADER *h);
 char *nm_uri_from_query(CONTEXT *ctx, char *buf, size_t bufsz);
 int nm_modify_message_tags(CONTEXT *ctx, HEADER *hdr, char *tags);
+int nm_modify_tagged_tags(CONTEXT *ctx, char *tags, int hide);
 
 void nm_longrun_init(CONTEXT *cxt, int writable);
 void nm_longrun_done(CONTEXT *cxt);
@@ -31,6 +34,7 @@ int nm_get_all_tags(CONTEXT *ctx, char **tag_list, int *tag_count);
  * functions usable outside notmuch CONTEXT
  */
 int nm_nonctx_get_count(char *path, int *all, int *new);
+void nm_nonctx_release_db(void);
 
 char *nm_header_get_tag_transformed(char *tag, HEADER *h);
 char *nm_header_get_tags_transformed(HEADER *h);
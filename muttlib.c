@@ -332,6 +332,7 @@ void mutt_free_header (HEADER **h)
   mutt_free_body (&(*h)->content);
   FREE (&(*h)->maildir_flags);
   FREE (&(*h)->tree);
+  FREE (&(*h)->index_line);
   FREE (&(*h)->path);
 #ifdef MIXMASTER
   mutt_free_list (&(*h)->chain);
@@ -1136,6 +1137,304 @@ void mutt_safe_path (char *s, size_t l, ADDRESS *a)
 }
 
 
+/*
+ * Compiled format strings.
+ *
+ * mutt_FormatString() runs for every index line, status line and sidebar
+ * entry drawn, nearly always with the same few templates.  Instead of
+ * re-parsing a template (and re-scanning each %<x?if&else> span) on every
+ * call, it is broken down into tokens once and kept in FormatCache, keyed
+ * by its contents.  Tokens are compiled lazily at the offsets expansion
+ * actually reaches, because callbacks may consume more input after their
+ * expando character (e.g. %[fmt] in $index_format).
+ */
+
+#define FMT_END		0	/* end of input or bad format */
+#define FMT_TEXT	1	/* literal text, escapes resolved */
+#define FMT_EXPANDO	2	/* expando handled by the callback */
+#define FMT_PAD		3	/* %>X or %*X: pad with X, then the rest */
+#define FMT_PAD_EOL	4	/* %|X: pad with X to end of line */
+
+#define FORMAT_CACHE_MAX 256
+
+typedef struct format_token
+{
+  short type;
+  char ch;			/* expando or padding type */
+  unsigned int optional : 1;	/* %<x?if&else> */
+  unsigned int tolower : 1;
+  unsigned int nodots : 1;
+  char *prefix;
+  char *ifstring;
+  char *elsestring;
+  char *text;			/* FMT_TEXT */
+  size_t len;			/* FMT_TEXT: bytes in text */
+  int width;			/* FMT_TEXT: screen columns of text */
+  size_t arg;			/* offset of input following the expando */
+  size_t next;			/* FMT_TEXT: offset of the following token */
+} FORMAT_TOKEN;
+
+typedef struct format_program
+{
+  char *key;			/* template as given */
+  char *src;			/* working copy, %?x?..? rewritten to %<x?..> */
+  size_t len;
+  FORMAT_TOKEN **tokens;	/* indexed by offset into src */
+} FORMAT_PROGRAM;
+
+static HASH *FormatCache = NULL;
+static int FormatCacheEntries = 0;
+static int FormatDepth = 0;	/* nesting of mutt_FormatString() calls */
+
+static void format_free_program (void *p)
+{
+  FORMAT_PROGRAM *prog = (FORMAT_PROGRAM *) p;
+  size_t i;
+
+  for (i = 0; i <= prog->len; i++)
+  {
+    FORMAT_TOKEN *tok = prog->tokens[i];
+
+    if (!tok)
+      continue;
+    FREE (&tok->prefix);
+    FREE (&tok->ifstring);
+    FREE (&tok->elsestring);
+    FREE (&tok->text);
+    FREE (&tok);
+  }
+  FREE (&prog->tokens);
+  FREE (&prog->key);
+  FREE (&prog->src);
+  FREE (&prog);
+}
+
+/* Drop all compiled templates, e.g. because $charset changed and the
+ * precomputed widths of literal text are no longer right. */
+void mutt_format_cache_flush (void)
+{
+  if (FormatCache && !FormatDepth)
+  {
+    hash_destroy (&FormatCache, format_free_program);
+    FormatCacheEntries = 0;
+  }
+}
+
+/* copy a %<x?if&else> branch, stopping at '&' (if part) or the closing '>' */
+static char *format_eat_branch (char **srcp, int *lrbalance, size_t maxlen)
+{
+  char *src = *srcp;
+  char *branch = safe_malloc (maxlen + 1);
+  char *cp = branch;
+
+  while ((*lrbalance > 0) && *src)
+  {
+    if (*src == '\\')
+    {
+      src++;
+      if (!*src)
+	break;
+      *cp++ = *src++;
+      if (!*src)
+	break;
+    }
+    else if ((src[0] == '%') && (src[1] == '<'))
+      (*lrbalance)++;
+    else if (src[0] == '>')
+      (*lrbalance)--;
+    if (*lrbalance == 0)
+      break;
+    if ((*lrbalance == 1) && (src[0] == '&'))
+      break;
+    *cp++ = *src++;
+  }
+  *cp = 0;
+
+  *srcp = src;
+  return branch;
+}
+
+static FORMAT_TOKEN *format_compile_token (FORMAT_PROGRAM *prog, size_t off)
+{
+  FORMAT_TOKEN *tok = safe_calloc (1, sizeof (FORMAT_TOKEN));
+  char *src = prog->src + off;
+  char *cp;
+
+  if (!*src)
+    return tok;		/* FMT_END */
+
+  if (*src != '%' || src[1] == '%')
+  {
+    int tmp, w;
+
+    tok->type = FMT_TEXT;
+    cp = tok->text = safe_malloc (prog->len - off + 1);
+    while (*src)
+    {
+      if (*src == '%')
+      {
+	if (src[1] != '%')
+	  break;
+	*cp++ = '%';
+	tok->width++;
+	src += 2;
+      }
+      else if (*src == '\\')
+      {
+	if (!*++src)
+	  break;
+	switch (*src)
+	{
+	  case 'n': *cp++ = '\n'; break;
+	  case 't': *cp++ = '\t'; break;
+	  case 'r': *cp++ = '\r'; break;
+	  case 'f': *cp++ = '\f'; break;
+	  case 'v': *cp++ = '\v'; break;
+	  default: *cp++ = *src; break;
+	}
+	tok->width++;
+	src++;
+      }
+      else
+      {
+	/* in case of error, simply copy byte */
+	if ((tmp = mutt_charlen (src, &w)) < 0)
+	  tmp = w = 1;
+	memcpy (cp, src, tmp);
+	cp += tmp;
+	src += tmp;
+	tok->width += w;
+      }
+    }
+    *cp = 0;
+    tok->len = cp - tok->text;
+    tok->next = src - prog->src;
+    return tok;
+  }
+
+  src++;
+  if (*src == '?')
+  {
+    /* change original %? to new %< notation */
+    /* %?x?y&z? to %<x?y&z> where y and z are nestable */
+    char *p = src;
+    *p = '<';
+    for ( ; *p && *p != '?'; p++)
+      ;
+    if (*p == '?')
+      p++;
+    for ( ; *p && *p != '?'; p++)
+      ;
+    if (*p == '?')
+      *p = '>';
+  }
+
+  if (*src == '<')
+  {
+    int lrbalance = 1;
+    size_t maxlen = prog->len - off;
+
+    tok->optional = 1;
+    if (!(tok->ch = *(++src)))
+      return tok;	/* bad format */
+    src++;
+    cp = tok->prefix = safe_malloc (maxlen + 1);
+    while (*src && *src != '?')
+      *cp++ = *src++;
+    *cp = 0;
+
+    if (*src != '?')
+      return tok;	/* bad format */
+    src++;
+
+    /* eat the `if' part of the string */
+    tok->ifstring = format_eat_branch (&src, &lrbalance, maxlen);
+
+    /* eat the `else' part of the string (optional) */
+    if (*src == '&')
+      src++; /* skip the & */
+    tok->elsestring = format_eat_branch (&src, &lrbalance, maxlen);
+
+    if (!*src)
+      return tok;	/* bad format */
+    src++; /* move past the trailing `>' (formerly '?') */
+  }
+  else
+  {
+    /* eat the format string */
+    cp = tok->prefix = safe_malloc (prog->len - off + 1);
+    while (isdigit ((unsigned char) *src) || *src == '.' || *src == '-' || *src == '=')
+      *cp++ = *src++;
+    *cp = 0;
+
+    if (!*src)
+      return tok;	/* bad format */
+    tok->ch = *src++;
+  }
+
+  if (tok->ch == '>' || tok->ch == '*')
+    tok->type = FMT_PAD;
+  else if (tok->ch == '|')
+    tok->type = FMT_PAD_EOL;
+  else
+  {
+    while (tok->ch == '_' || tok->ch == ':')
+    {
+      if (tok->ch == '_')
+	tok->tolower = 1;
+      else
+	tok->nodots = 1;
+      if (!(tok->ch = *src++))
+	return tok;	/* bad format */
+    }
+    tok->type = FMT_EXPANDO;
+  }
+
+  tok->arg = src - prog->src;
+  return tok;
+}
+
+static FORMAT_PROGRAM *format_new_program (const char *src)
+{
+  FORMAT_PROGRAM *prog = safe_calloc (1, sizeof (FORMAT_PROGRAM));
+
+  prog->key = safe_strdup (src);
+  prog->src = safe_strdup (src);
+  prog->len = mutt_strlen (src);
+  prog->tokens = safe_calloc (prog->len + 1, sizeof (FORMAT_TOKEN *));
+  return prog;
+}
+
+/* Look up the compiled form of a template.  *tmp is set when the program
+ * couldn't be cached and has to be freed by the caller. */
+static FORMAT_PROGRAM *format_get_program (const char *src, int *tmp)
+{
+  FORMAT_PROGRAM *prog;
+
+  *tmp = 0;
+  if (FormatCache && (prog = hash_find (FormatCache, src)))
+    return prog;
+
+  prog = format_new_program (src);
+
+  if (FormatCacheEntries >= FORMAT_CACHE_MAX)
+  {
+    /* programs further up the stack are still in use */
+    if (FormatDepth)
+    {
+      *tmp = 1;
+      return prog;
+    }
+    mutt_format_cache_flush ();
+  }
+
+  if (!FormatCache)
+    FormatCache = hash_create (FORMAT_CACHE_MAX, 0);
+  hash_insert (FormatCache, prog->key, prog, 0);
+  FormatCacheEntries++;
+  return prog;
+}
+
 void mutt_FormatString (char *dest,		/* output buffer */
 			size_t destlen,		/* output buffer len */
 			size_t col,		/* starting column (nonzero when called recursively) */
@@ -1144,15 +1443,15 @@ void mutt_FormatString (char *dest,		/* output buffer */
 			unsigned long data,	/* callback data */
 			format_flag flags)	/* callback flags */
 {
-  char prefix[SHORT_STRING], buf[LONG_STRING], *cp, *wptr = dest, ch;
-  char ifstring[SHORT_STRING], elsestring[SHORT_STRING];
-  size_t wlen, count, len, wid;
+  char buf[LONG_STRING], *cp, *wptr = dest;
+  size_t wlen, len, wid, off = 0;
   pid_t pid;
   FILE *filter;
-  int n;
+  int n, tmp_prog;
   char *recycler;
+  FORMAT_PROGRAM *prog;
+  FORMAT_TOKEN *tok;
 
-  prefix[0] = '\0';
   destlen--; /* save room for the terminal \0 */
   wlen = ((flags & M_FORMAT_ARROWCURSOR) && option (OPTARROWCURSOR)) ? 3 : 0;
   col += wlen;
@@ -1284,301 +1583,176 @@ void mutt_FormatString (char *dest,		/* output buffer */
     }
   }
 
-  while (*src && wlen < destlen)
+  if (!src || !*src)
   {
-    if (*src == '%')
-    {
-      if (*++src == '%')
-      {
-	*wptr++ = '%';
-	wlen++;
-	col++;
-	src++;
-	continue;
-      }
-
-      if (*src == '?')
-      {
-	/* change original %? to new %< notation */
-	/* %?x?y&z? to %<x?y&z> where y and z are nestable */
-	char *p = (char *) src;
-	*p = '<';
-	for ( ; *p && *p != '?'; p++);
-	  /* nothing */
-	if (*p == '?') {
-	  p++;
-	}
-	for ( ; *p && *p != '?'; p++);
-	  /* nothing */
-	if (*p == '?') {
-	  *p = '>';
-	}
-      }
-
-      if (*src == '<')
-      {
-	flags |= M_FORMAT_OPTIONAL;
-	ch = *(++src); /* save the character to switch on */
-	src++;
-	cp = prefix;
-	count = 0;
-	while ((count < sizeof (prefix)) && (*src != '?')) {
-	  *cp++ = *src++;
-	  count++;
-	}
-	*cp = 0;
-      }
-      else
-      {
-	flags &= ~M_FORMAT_OPTIONAL;
+    *wptr = 0;
+    return;
+  }
 
-	/* eat the format string */
-	cp = prefix;
-	count = 0;
-	while (count < sizeof (prefix) &&
-	       (isdigit ((unsigned char) *src) || *src == '.' || *src == '-' || *src == '='))
-	{
-	  *cp++ = *src++;
-	  count++;
-	}
-	*cp = 0;
+  prog = format_get_program (src, &tmp_prog);
+  FormatDepth++;
 
-	if (!*src)
-	  break; /* bad format */
+  while (wlen < destlen)
+  {
+    if (!(tok = prog->tokens[off]))
+      tok = prog->tokens[off] = format_compile_token (prog, off);
 
-	ch = *src++; /* save the character to switch on */
-      }
+    if (tok->type == FMT_END)
+      break;
 
-      if (flags & M_FORMAT_OPTIONAL)
+    if (tok->type == FMT_TEXT)
+    {
+      if (wlen + tok->len < destlen)
       {
-	int lrbalance;
-
-        if (*src != '?')
-          break; /* bad format */
-        src++;
-
-        /* eat the `if' part of the string */
-        cp = ifstring;
-	count = 0;
-	lrbalance = 1;
-        while ((lrbalance > 0) && (count < sizeof (ifstring)) && *src) {
-	  if (*src == '\\') {
-	    src++;
-	    *cp++ = *src++;
-	  } else if ((src[0] == '%') && (src[1] == '<')) {
-	    lrbalance++;
-	  } else if (src[0] == '>') {
-	    lrbalance--;
-	  }
-	  if (lrbalance == 0)
-	    break;
-	  if ((lrbalance == 1) && (src[0] == '&'))
-	    break;
-          *cp++ = *src++;
-	  count++;
-	}
-        *cp = 0;
-
-	/* eat the `else' part of the string (optional) */
-	if (*src == '&')
-	  src++; /* skip the & */
-	cp = elsestring;
-	count = 0;
-	while ((lrbalance > 0) && (count < sizeof (elsestring)) && *src) {
-	  if (*src == '\\') {
-	    src++;
-	    *cp++ = *src++;
-	  } else if ((src[0] == '%') && (src[1] == '<')) {
-	    lrbalance++;
-	  } else if (src[0] == '>') {
-	    lrbalance--;
-	  }
-	  if (lrbalance == 0)
-	    break;
-	  if ((lrbalance == 1) && (src[0] == '&'))
-	    break;
-          *cp++ = *src++;
-	  count++;
-	}
-	*cp = 0;
-
-	if (!*src)
-	  break; /* bad format */
-
-        src++; /* move past the trailing `>' (formerly '?') */
+	memcpy (wptr, tok->text, tok->len);
+	wptr += tok->len;
+	wlen += tok->len;
+	col += tok->width;
       }
-
-      /* handle generic cases first */
-      if (ch == '>' || ch == '*')
+      else
       {
-	/* %>X: right justify to EOL, left takes precedence
-	 * %*X: right justify to EOL, right takes precedence */
-	int soft = ch == '*';
-	int pl, pw;
-	if ((pl = mutt_charlen (src, &pw)) <= 0)
-	  pl = pw = 1;
-
-	/* see if there's room to add content, else ignore */
-	if ((col < (COLS - SidebarWidth) && (wlen < destlen)) || soft)
+	/* not everything fits, copy what does */
+	for (cp = tok->text; cp < tok->text + tok->len && wlen < destlen; )
 	{
-	  int pad;
-
-	  /* get contents after padding */
-	  mutt_FormatString (buf, sizeof (buf), 0, src + pl, callback, data, flags);
-	  len = mutt_strlen (buf);
-	  wid = mutt_strwidth (buf);
-
-	  /* try to consume as many columns as we can, if we don't have
-	   * memory for that, use as much memory as possible */
-	  pad = (COLS - SidebarWidth - col - wid) / pw;
-	  if (pad > 0 && wlen + (pad * pl) + len > destlen)
-	    pad = ((signed)(destlen - wlen - len)) / pl;
-	  if (pad > 0)
-	  {
-	    while (pad--)
-	    {
-	      memcpy (wptr, src, pl);
-	      wptr += pl;
-	      wlen += pl;
-	      col += pw;
-	    }
-	  }
-	  else if (soft && pad < 0)
+	  int tmp, w;
+
+	  if ((tmp = mutt_charlen (cp, &w)) <= 0)
+	    tmp = w = 1;
+	  if (wlen + tmp < destlen || (tmp == 1 && wlen < destlen))
 	  {
-	    int offset = ((flags & M_FORMAT_ARROWCURSOR) && option (OPTARROWCURSOR)) ? 3 : 0;
-	    /* \0-terminate dest for length computation in mutt_wstr_trunc() */
-	    *wptr = 0;
-	    /* make sure right part is at most as wide as display */
-	    len = mutt_wstr_trunc (buf, destlen, COLS - offset - SidebarWidth, &wid);
-	    /* truncate left so that right part fits completely in */
-	    wlen = mutt_wstr_trunc (dest, destlen - len, col + pad*pw -offset, &col);
-	    wptr = dest + wlen;
+	    memcpy (wptr, cp, tmp);
+	    wptr += tmp;
+	    cp += tmp;
+	    wlen += tmp;
+	    col += w;
 	  }
-	  if (len + wlen > destlen)
-	    len = mutt_wstr_trunc (buf, destlen - wlen, COLS - SidebarWidth - col, NULL);
-	  memcpy (wptr, buf, len);
-	  wptr += len;
-	  wlen += len;
-	  col += wid;
-	  src += pl;
+	  else
+	    wlen = destlen;
 	}
-	break; /* skip rest of input */
       }
-      else if (ch == '|')
-      {
-	/* pad to EOL */
-	int pl, pw, c;
-	if ((pl = mutt_charlen (src, &pw)) <= 0)
-	  pl = pw = 1;
+      off = tok->next;
+      continue;
+    }
 
-	/* see if there's room to add content, else ignore */
-	if (col < COLS && wlen < destlen)
+    if (tok->optional)
+      flags |= M_FORMAT_OPTIONAL;
+    else
+      flags &= ~M_FORMAT_OPTIONAL;
+
+    /* handle generic cases first */
+    if (tok->type == FMT_PAD)
+    {
+      /* %>X: right justify to EOL, left takes precedence
+       * %*X: right justify to EOL, right takes precedence */
+      const char *padchar = prog->src + tok->arg;
+      int soft = tok->ch == '*';
+      int pl, pw;
+      if ((pl = mutt_charlen (padchar, &pw)) <= 0)
+	pl = pw = 1;
+
+      /* see if there's room to add content, else ignore */
+      if ((col < (COLS - SidebarWidth) && (wlen < destlen)) || soft)
+      {
+	int pad;
+
+	/* get contents after padding */
+	mutt_FormatString (buf, sizeof (buf), 0, padchar + pl, callback, data, flags);
+	len = mutt_strlen (buf);
+	wid = mutt_strwidth (buf);
+
+	/* try to consume as many columns as we can, if we don't have
+	 * memory for that, use as much memory as possible */
+	pad = (COLS - SidebarWidth - col - wid) / pw;
+	if (pad > 0 && wlen + (pad * pl) + len > destlen)
+	  pad = ((signed)(destlen - wlen - len)) / pl;
+	if (pad > 0)
 	{
-	  c = (COLS - col) / pw;
-	  if (c > 0 && wlen + (c * pl) > destlen)
-	    c = ((signed)(destlen - wlen)) / pl;
-	  while (c > 0)
+	  while (pad--)
 	  {
-	    memcpy (wptr, src, pl);
+	    memcpy (wptr, padchar, pl);
 	    wptr += pl;
 	    wlen += pl;
 	    col += pw;
-	    c--;
 	  }
-	  src += pl;
-	}
-	break; /* skip rest of input */
-      }
-      else
-      {
-	short tolower =  0;
-	short nodots  = 0;
-	
-	while (ch == '_' || ch == ':') 
-	{
-	  if (ch == '_')
-	    tolower = 1;
-	  else if (ch == ':') 
-	    nodots = 1;
-	  
-	  ch = *src++;
 	}
-	
-	/* use callback function to handle this case */
-	src = callback (buf, sizeof (buf), col, ch, src, prefix, ifstring, elsestring, data, flags);
-
-	if (tolower)
-	  mutt_strlower (buf);
-	if (nodots) 
+	else if (soft && pad < 0)
 	{
-	  char *p = buf;
-	  for (; *p; p++)
-	    if (*p == '.')
-		*p = '_';
+	  int offset = ((flags & M_FORMAT_ARROWCURSOR) && option (OPTARROWCURSOR)) ? 3 : 0;
+	  /* \0-terminate dest for length computation in mutt_wstr_trunc() */
+	  *wptr = 0;
+	  /* make sure right part is at most as wide as display */
+	  len = mutt_wstr_trunc (buf, destlen, COLS - offset - SidebarWidth, &wid);
+	  /* truncate left so that right part fits completely in */
+	  wlen = mutt_wstr_trunc (dest, destlen - len, col + pad*pw -offset, &col);
+	  wptr = dest + wlen;
 	}
-	
-	if ((len = mutt_strlen (buf)) + wlen > destlen)
-	  len = mutt_wstr_trunc (buf, destlen - wlen, COLS - col, NULL);
-
+	if (len + wlen > destlen)
+	  len = mutt_wstr_trunc (buf, destlen - wlen, COLS - SidebarWidth - col, NULL);
 	memcpy (wptr, buf, len);
 	wptr += len;
 	wlen += len;
-	col += mutt_strwidth (buf);
+	col += wid;
       }
+      break; /* skip rest of input */
     }
-    else if (*src == '\\')
+    else if (tok->type == FMT_PAD_EOL)
     {
-      if (!*++src)
-	break;
-      switch (*src)
+      /* pad to EOL */
+      const char *padchar = prog->src + tok->arg;
+      int pl, pw, c;
+      if ((pl = mutt_charlen (padchar, &pw)) <= 0)
+	pl = pw = 1;
+
+      /* see if there's room to add content, else ignore */
+      if (col < COLS && wlen < destlen)
       {
-	case 'n':
-	  *wptr = '\n';
-	  break;
-	case 't':
-	  *wptr = '\t';
-	  break;
-	case 'r':
-	  *wptr = '\r';
-	  break;
-	case 'f':
-	  *wptr = '\f';
-	  break;
-	case 'v':
-	  *wptr = '\v';
-	  break;
-	default:
-	  *wptr = *src;
-	  break;
+	c = (COLS - col) / pw;
+	if (c > 0 && wlen + (c * pl) > destlen)
+	  c = ((signed)(destlen - wlen)) / pl;
+	while (c > 0)
+	{
+	  memcpy (wptr, padchar, pl);
+	  wptr += pl;
+	  wlen += pl;
+	  col += pw;
+	  c--;
+	}
       }
-      src++;
-      wptr++;
-      wlen++;
-      col++;
+      break; /* skip rest of input */
     }
     else
     {
-      int tmp, w;
-      /* in case of error, simply copy byte */
-      if ((tmp = mutt_charlen (src, &w)) < 0)
-	tmp = w = 1;
-      if (tmp > 0 && wlen + tmp < destlen)
-      {
-        memcpy (wptr, src, tmp);
-        wptr += tmp;
-        src += tmp;
-        wlen += tmp;
-        col += w;
-      }
-      else
+      /* use callback function to handle this case */
+      cp = (char *) callback (buf, sizeof (buf), col, tok->ch, prog->src + tok->arg,
+			      tok->prefix, NONULL (tok->ifstring), NONULL (tok->elsestring),
+			      data, flags);
+      off = cp - prog->src;
+
+      if (tok->tolower)
+	mutt_strlower (buf);
+      if (tok->nodots)
       {
-	src += destlen - wlen;
-	wlen = destlen;
+	char *p = buf;
+	for (; *p; p++)
+	  if (*p == '.')
+	      *p = '_';
       }
+
+      if ((len = mutt_strlen (buf)) + wlen > destlen)
+	len = mutt_wstr_trunc (buf, destlen - wlen, COLS - col, NULL);
+
+      memcpy (wptr, buf, len);
+      wptr += len;
+      wlen += len;
+      col += mutt_strwidth (buf);
     }
   }
   *wptr = 0;
 
+  FormatDepth--;
+  if (tmp_prog)
+    format_free_program (prog);
+
 #if 0
   if (flags & M_FORMAT_MAKEPRINT)
   {
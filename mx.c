@@ -47,6 +47,10 @@
 
 #include "buffy.h"
 
+#ifdef USE_INOTIFY
+#include "monitor.h"
+#endif
+
 #ifdef USE_DOTLOCK
 #include "dotlock.h"
 #endif
@@ -767,6 +771,10 @@ void mx_fastclose_mailbox (CONTEXT *ctx)
 #endif
   mutt_buffy_setnotified(ctx->path);
 
+#ifdef USE_INOTIFY
+  mutt_monitor_unwatch_context (ctx);
+#endif
+
   if (ctx->mx_close)
     ctx->mx_close (ctx);
 
@@ -1381,6 +1389,12 @@ int mx_check_mailbox (CONTEXT *ctx, int *index_hint, int lock)
   {
     if (ctx->locked) lock = 0;
 
+#ifdef USE_INOTIFY
+    /* nothing can have changed in a watched folder without an event */
+    if (!mutt_monitor_context_changed (ctx) && !lock)
+      return 0;
+#endif
+
     switch (ctx->magic)
     {
       case M_MBOX:
@@ -1478,6 +1492,10 @@ MESSAGE *mx_open_message (CONTEXT *ctx, int msgno)
 		    path, strerror (errno), errno));
 	FREE (&msg);
       }
+#ifdef USE_NOTMUCH
+      else if (ctx->magic == M_NOTMUCH)
+	nm_read_partial_header (cur, msg->fp);
+#endif
     }
     break;
     
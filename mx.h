@@ -77,6 +77,7 @@ void maildir_flags(char *dest, size_t destlen, HEADER * hdr);
 #if USE_HCACHE
 #include <hcache.h>
 int mh_sync_mailbox_message (CONTEXT * ctx, int msgno, header_cache_t *hc);
+size_t maildir_hcache_keylen (const char *fn);
 #else
 int mh_sync_mailbox_message (CONTEXT * ctx, int msgno);
 #endif
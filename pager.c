@@ -115,6 +115,7 @@ struct line_t
   struct syntax_t *search;
   struct q_class_t *quote;
   unsigned int is_cont_hdr; /* this line is a continuation of the previous header line */
+  unsigned int sig_known; /* whether it is in a signature is known, see sig_catch_up() */
 };
 
 #define ANSI_OFF       (1<<0)
@@ -704,6 +705,12 @@ classify_quote (struct q_class_t **QuoteList, const char *qptr,
 static int brailleLine = -1;
 static int brailleCol = -1;
 
+/* line buffers shared by all display_line() calls, so that paging through
+ * a long message doesn't allocate and free two buffers per line */
+static unsigned char *LineBuf = NULL;
+static unsigned char *LineFmt = NULL;
+static size_t LineBufLen = 0;
+
 static int check_attachment_marker (char *);
 
 static void
@@ -1258,6 +1265,84 @@ static int format_line (struct line_t **lineInfo, int n, unsigned char *buf,
   return ch;
 }
 
+/*
+ * Lines may be drawn without the ones above them having been classified
+ * (see OP_PAGER_BOTTOM), but whether a line is in a signature depends on
+ * all the lines back to its "-- ".  Work that out for the lines above n by
+ * looking back for a "-- " line, or a line whose state is known, comparing
+ * only the raw text instead of running resolve_types() on every line.
+ * Lines in a signature get their class, the others are left to be
+ * classified when they are drawn.
+ */
+static void
+sig_catch_up (FILE *f, LOFF_T *last_pos, struct line_t *lineInfo, int n,
+	      unsigned char **buf, unsigned char **fmt, size_t *buflen)
+{
+  char *kind;	/* 'd' for a "-- " line, 'b' for a blank one, 'x' for one
+		 * which never is in a signature */
+  unsigned char *p;
+  int buf_ready, cnt, m, i;
+
+  kind = safe_calloc (n, 1);
+  for (m = n - 1; m >= 0 && lineInfo[m].type == -1 && !lineInfo[m].sig_known; m--)
+  {
+    if (lineInfo[m].continuation)
+      continue;
+    buf_ready = 0;
+    if (fill_buffer (f, last_pos, lineInfo[m].offset, buf, fmt, buflen, &buf_ready) < 0)
+      continue;
+    if (mutt_strcmp ("-- \n", (char *) *fmt) == 0 ||
+	mutt_strcmp ("-- \r\n", (char *) *fmt) == 0)
+    {
+      kind[m] = 'd';
+      break;
+    }
+    if (mutt_strncmp ("\033[0m", (char *) *buf, 4) == 0 ||
+	check_attachment_marker ((char *) *buf) == 0)
+      kind[m] = 'x';
+    else
+    {
+      for (p = *fmt; *p && ISSPACE (*p); p++)
+	;
+      if (!*p)
+	kind[m] = 'b';
+    }
+  }
+
+  /* how many signature lines end at m, as far as check_sig() counts */
+  cnt = 0;
+  if (m >= 0 && kind[m] == 'd')
+  {
+    lineInfo[m].type = MT_COLOR_SIGNATURE;
+    lineInfo[m].sig_known = 1;
+    cnt = 1;
+  }
+  else
+    for (i = m; i >= 0 && cnt <= NumSigLines &&
+	   lineInfo[i].type == MT_COLOR_SIGNATURE; i--)
+      cnt++;
+
+  for (i = m + 1; i < n; i++)
+  {
+    if (lineInfo[i].continuation)
+      cnt = cnt ? cnt + 1 : 0;
+    else if (kind[i] == 'x')
+      cnt = 0;
+    else if (cnt && (cnt <= NumSigLines || kind[i] != 'b'))
+      cnt++;
+    else
+      cnt = 0;
+    if (cnt > NumSigLines + 1)
+      cnt = NumSigLines + 1;
+
+    if (cnt)
+      lineInfo[i].type = MT_COLOR_SIGNATURE;
+    lineInfo[i].sig_known = 1;
+  }
+
+  FREE (&kind);
+}
+
 /*
  * Args:
  *	flags	M_SHOWFLAT, show characters (used for displaying help)
@@ -1280,8 +1365,8 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
 	      int *last, int *max, int flags, struct q_class_t **QuoteList,
 	      int *q_level, int *force_redraw, regex_t *SearchRE)
 {
-  unsigned char *buf = NULL, *fmt = NULL;
-  size_t buflen = 0;
+  unsigned char *buf = LineBuf, *fmt = LineFmt;
+  size_t buflen = LineBufLen;
   unsigned char *buf_ptr = buf;
   int ch, vch, col, cnt, b_read;
   int buf_ready = 0, change_last = 0;
@@ -1301,7 +1386,8 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
 
   if (*last == *max)
   {
-    safe_realloc (lineInfo, sizeof (struct line_t) * (*max += LINES));
+    /* grow geometrically, long messages would otherwise be quadratic */
+    safe_realloc (lineInfo, sizeof (struct line_t) * (*max += MAX (*max, LINES)));
     for (ch = *last; ch < *max ; ch++)
     {
       memset (&((*lineInfo)[ch]), 0, sizeof (struct line_t));
@@ -1317,6 +1403,11 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
   {
     if ((*lineInfo)[n].type == -1)
     {
+      /* tell whether we are inside a signature */
+      if ((flags & M_SHOWCOLOR) && n > 0 && (*lineInfo)[n-1].type == -1 &&
+	  !(*lineInfo)[n-1].sig_known)
+	sig_catch_up (f, last_pos, *lineInfo, n, &buf, &fmt, &buflen);
+
       /* determine the line class */
       if (fill_buffer (f, last_pos, (*lineInfo)[n].offset, &buf, &fmt, &buflen, &buf_ready) < 0)
       {
@@ -1516,11 +1607,58 @@ display_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
   rc = flags;
 
 out:
-  FREE(&buf);
-  FREE(&fmt);
+  LineBuf = buf;
+  LineFmt = fmt;
+  LineBufLen = buflen;
   return rc;
 }
 
+/*
+ * Find the next line matching the current search, starting at line n and
+ * going into direction dir.  Lines are only searched (and, going forward,
+ * broken up) as far as needed, so a hit near the top of a long message
+ * doesn't require scanning all of it.
+ *
+ * Return values:
+ *	>=0	index of the matching line
+ *	-1	no further match
+ *	-2	the search was interrupted
+ */
+static int
+search_line (FILE *f, LOFF_T *last_pos, struct line_t **lineInfo, int n,
+	     int dir, int *last, int *max, int flags, int hideQuoted,
+	     struct q_class_t **QuoteList, int *q_level, int *force_redraw,
+	     regex_t *SearchRE)
+{
+  /* only the line right after the last one parsed can be added, so don't
+   * start beyond it; going back, start at the last parsed line */
+  if (n > *last || (dir < 0 && n == *last))
+    n = dir > 0 ? *last : *last - 1;
+
+  for (; n >= 0; n += dir)
+  {
+    if (n >= *last || (*lineInfo)[n].search_cnt == -1)
+    {
+      if (display_line (f, last_pos, lineInfo, n, last, max, M_SEARCH | flags,
+			QuoteList, q_level, force_redraw, SearchRE) < 0)
+	break;
+    }
+
+    if ((!hideQuoted || (*lineInfo)[n].type != MT_COLOR_QUOTED) &&
+	!(*lineInfo)[n].continuation && (*lineInfo)[n].search_cnt > 0)
+      return n;
+
+    if (SigInt)
+    {
+      mutt_error _("Search interrupted.");
+      SigInt = 0;
+      return -2;
+    }
+  }
+
+  return -1;
+}
+
 static int
 upNLines (int nlines, struct line_t *info, int cur, int hiding)
 {
@@ -1940,6 +2078,7 @@ mutt_pager (const char *banner, const char *fname, int flags, pager_t *extra)
 	{
 	  lineInfo[i].offset = 0;
 	  lineInfo[i].type = -1;
+	  lineInfo[i].sig_known = 0;
 	  lineInfo[i].continuation = 0;
 	  lineInfo[i].chunks = 0;
 	  lineInfo[i].search_cnt = -1;
@@ -2084,15 +2223,16 @@ search_next:
 	      (SearchBack &&ch==OP_SEARCH_OPPOSITE))
 	  {
 	    /* searching forward */
-	    for (i = wrapped ? 0 : topline + searchctx + 1; i < lastLine; i++)
-	    {
-	      if ((!hideQuoted || lineInfo[i].type != MT_COLOR_QUOTED) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
+	    i = search_line (fp, &last_pos, &lineInfo,
+			     wrapped ? 0 : topline + searchctx + 1, 1,
+			     &lastLine, &maxLine,
+			     flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP), hideQuoted,
+			     &QuoteList, &q_level, &force_redraw, &SearchRE);
 
-	    if (i < lastLine)
+	    if (i >= 0)
 	      topline = i;
+	    else if (i == -2)
+	      break;
 	    else if (wrapped || !option (OPTWRAPSEARCH))
 	      mutt_error _("Not found.");
 	    else
@@ -2105,16 +2245,27 @@ search_next:
 	  else
 	  {
 	    /* searching backward */
-	    for (i = wrapped ? lastLine : topline + searchctx - 1; i >= 0; i--)
+	    if (wrapped)
 	    {
-	      if ((!hideQuoted || (has_types && 
-		    lineInfo[i].type != MT_COLOR_QUOTED)) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
+	      /* the bottom part may not have been looked at yet */
+	      i = lastLine;
+	      while (display_line (fp, &last_pos, &lineInfo, i, &lastLine,
+				   &maxLine, flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP),
+				   &QuoteList, &q_level, &force_redraw,
+				   &SearchRE) == 0)
+		i++;
 	    }
 
+	    i = search_line (fp, &last_pos, &lineInfo,
+			     wrapped ? lastLine - 1 : topline + searchctx - 1, -1,
+			     &lastLine, &maxLine,
+			     flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP), hideQuoted,
+			     &QuoteList, &q_level, &force_redraw, &SearchRE);
+
 	    if (i >= 0)
 	      topline = i;
+	    else if (i == -2)
+	      break;
 	    else if (wrapped || !option (OPTWRAPSEARCH))
 	      mutt_error _("Not found.");
 	    else
@@ -2200,40 +2351,17 @@ search_next:
 	else
 	{
 	  SearchCompiled = 1;
-	  /* update the search pointers */
-	  i = 0;
-	  while (display_line (fp, &last_pos, &lineInfo, i, &lastLine, 
-				&maxLine, M_SEARCH | (flags & M_PAGER_NSKIP) | (flags & M_PAGER_NOWRAP),
-				&QuoteList, &q_level,
-				&force_redraw, &SearchRE) == 0)
-	    i++;
-
-	  if (!SearchBack)
-	  {
-	    /* searching forward */
-	    for (i = topline; i < lastLine; i++)
-	    {
-	      if ((!hideQuoted || lineInfo[i].type != MT_COLOR_QUOTED) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
-
-	    if (i < lastLine) topline = i;
-	  }
-	  else
-	  {
-	    /* searching backward */
-	    for (i = topline; i >= 0; i--)
-	    {
-	      if ((!hideQuoted || lineInfo[i].type != MT_COLOR_QUOTED) && 
-		    !lineInfo[i].continuation && lineInfo[i].search_cnt > 0)
-		break;
-	    }
-
-	    if (i >= 0) topline = i;
-	  }
-
-	  if (lineInfo[topline].search_cnt == 0)
+	  /* lines are searched lazily, as far as needed to find a match */
+	  i = search_line (fp, &last_pos, &lineInfo, topline, SearchBack ? -1 : 1,
+			   &lastLine, &maxLine,
+			   flags & (M_PAGER_NSKIP | M_PAGER_NOWRAP), hideQuoted,
+			   &QuoteList, &q_level, &force_redraw, &SearchRE);
+	  if (i >= 0)
+	    topline = i;
+
+	  if (i == -2)
+	    SearchFlag = 0;
+	  else if (i == -1)
 	  {
 	    SearchFlag = 0;
 	    mutt_error _("Not found.");
@@ -2325,9 +2453,11 @@ search_next:
 	if (lineInfo[curline].offset < sb.st_size - 1)
 	{
 	  i = curline;
-	  /* make sure the types are defined to the end of file */
+	  /* find the line breaks up to the end of file.  Line types are only
+	   * needed for that when quoted text is hidden; otherwise the lines
+	   * get classified lazily once they are displayed. */
 	  while (display_line (fp, &last_pos, &lineInfo, i, &lastLine, 
-				&maxLine, has_types | (flags & M_PAGER_NOWRAP),
+				&maxLine, (hideQuoted ? has_types : 0) | (flags & M_PAGER_NOWRAP),
 				&QuoteList, &q_level, &force_redraw,
 				&SearchRE) == 0)
 	    i++;
@@ -2506,6 +2636,7 @@ search_next:
 	  {
 	    lineInfo[i].offset = 0;
 	    lineInfo[i].type = -1;
+	    lineInfo[i].sig_known = 0;
 	    lineInfo[i].continuation = 0;
 	    lineInfo[i].chunks = 0;
 	    lineInfo[i].search_cnt = -1;
@@ -2860,6 +2991,10 @@ search_next:
   }
     
   cleanup_quote (&QuoteList);
+
+  FREE (&LineBuf);
+  FREE (&LineFmt);
+  LineBufLen = 0;
   
   for (i = 0; i < maxLine ; i++)
   {
@@ -29,6 +29,11 @@
 #include "mutt_crypt.h"
 #include "url.h"
 
+#ifdef USE_NOTMUCH
+#include "mx.h"
+#include "mutt_notmuch.h"
+#endif
+
 #include <string.h>
 #include <ctype.h>
 #include <sys/stat.h>
@@ -954,6 +959,14 @@ void mutt_parse_mime_message (CONTEXT *ctx, HEADER *cur)
 {
   MESSAGE *msg;
 
+#ifdef USE_NOTMUCH
+  /* the MIME structure of headers set up from the notmuch index is
+   * read when the message is opened */
+  if (ctx->magic == M_NOTMUCH && nm_header_is_partial (cur) &&
+      (msg = mx_open_message (ctx, cur->msgno)))
+    mx_close_message (&msg);
+#endif
+
   do {
     if (cur->content->type != TYPEMESSAGE &&
         cur->content->type != TYPEMULTIPART)
@@ -1625,7 +1638,7 @@ int mutt_count_body_parts (CONTEXT *ctx, HEADER *hdr)
 {
   short keep_parts = 0;
 
-  if (hdr->attach_valid)
+  if (hdr->attach_valid && hdr->attach_stamp == AttachStamp)
     return hdr->attach_total;
   
   if (hdr->content->parts)
@@ -1639,6 +1652,8 @@ int mutt_count_body_parts (CONTEXT *ctx, HEADER *hdr)
     hdr->attach_total = 0;
 
   hdr->attach_valid = 1;
+  hdr->attach_stamp = AttachStamp;
+  hdr->attach_dirty = 1;
   
   if (!keep_parts)
     mutt_free_body (&hdr->content->parts);
@@ -885,6 +885,8 @@ BODY *pgp_decrypt_part (BODY *a, STATE *s, FILE *fpout, BODY *p)
   int len;
   char pgperrfile[_POSIX_PATH_MAX];
   char pgptmpfile[_POSIX_PATH_MAX];
+  unsigned char digest[16];
+  LOFF_T outpos;
   pid_t thepid;
   int rv;
   
@@ -896,6 +898,11 @@ BODY *pgp_decrypt_part (BODY *a, STATE *s, FILE *fpout, BODY *p)
   }
   unlink (pgperrfile);
 
+  outpos = ftello (fpout);
+  if (crypt_decrypted_lookup (s->fpin, a->offset, a->length, 0, digest,
+			      fpout, pgperr, &rv) == 0)
+    goto decrypted;
+
   mutt_mktemp (pgptmpfile, sizeof (pgptmpfile));
   if((pgptmp = safe_fopen (pgptmpfile, "w")) == NULL)
   {
@@ -954,6 +961,10 @@ BODY *pgp_decrypt_part (BODY *a, STATE *s, FILE *fpout, BODY *p)
     return NULL;
   }
 
+  crypt_decrypted_store (digest, 0, fpout, outpos, pgperr, rv);
+
+decrypted:
+
   if (s->flags & M_DISPLAY)
   {
     rewind (pgperr);
@@ -52,6 +52,7 @@ pgp_key_t pgp_ask_for_key (char *, char *, short, pgp_ring_t);
 pgp_key_t pgp_get_candidates (pgp_ring_t, LIST *);
 pgp_key_t pgp_getkeybyaddr (ADDRESS *, short, pgp_ring_t, int);
 pgp_key_t pgp_getkeybystr (char *, short, pgp_ring_t);
+void pgp_forget_pubring (void);
 
 char *pgp_findKeys (ADDRESS *adrlist, int oppenc_mode);
 
@@ -273,6 +273,7 @@ void pgp_invoke_import (const char *fname)
   
   mutt_pgp_command (cmd, sizeof (cmd), &cctx, PgpImportCommand);
   mutt_system (cmd);
+  pgp_forget_pubring ();
 }
 
 void pgp_invoke_getkeys (ADDRESS *addr)
@@ -309,6 +310,7 @@ void pgp_invoke_getkeys (ADDRESS *addr)
   if (!isendwin ()) mutt_message  _("Fetching PGP key...");
 
   mutt_system (cmd);
+  pgp_forget_pubring ();
 
   if (!isendwin ()) mutt_clear_error ();
 
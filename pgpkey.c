@@ -813,6 +813,165 @@ static pgp_key_t *pgp_get_lastp (pgp_key_t p)
   return NULL;
 }
 
+/*
+ * An index of the public keyring by the mailboxes and names on its user
+ * ids.  It is built from a single listing of the whole keyring and kept
+ * until the keyring files change or keys are imported, so that looking up
+ * a long list of recipients doesn't run $pgp_list_pubring_command once for
+ * each.
+ */
+static pgp_key_t PubringKeys = NULL;
+static HASH *PubringIndex = NULL;
+static LIST *PubringNames = NULL;
+static time_t PubringBuilt = 0;	/* when the index was built */
+static char *PubringCommand = NULL;	/* $pgp_list_pubring_command it was built with */
+
+static void pgp_pubring_index_add (const char *name, pgp_key_t k)
+{
+  LIST *l;
+
+  if (!name || !*name)
+    return;
+
+  l = mutt_new_list ();
+  l->data = safe_strdup (name);
+  l->next = PubringNames;
+  PubringNames = l;
+  hash_insert (PubringIndex, l->data, k, 1);
+}
+
+void pgp_forget_pubring (void)
+{
+  if (PubringIndex)
+    hash_destroy (&PubringIndex, NULL);
+  mutt_free_list (&PubringNames);
+  pgp_free_key (&PubringKeys);
+  FREE (&PubringCommand);
+  PubringBuilt = 0;
+}
+
+/* (Re)build the index if the keyring has changed.  Returns 0 if there
+ * is no usable index, in which case the caller should ask the PGP
+ * program directly. */
+static int pgp_pubring_index (void)
+{
+  ADDRESS *r, *p;
+  pgp_uid_t *q;
+  pgp_key_t k;
+  time_t stamp, now;
+  int n;
+
+  /* without knowing its files, a change to the keyring can't be told */
+  if (!(stamp = crypt_keyring_stamp (0, PgpListPubringCommand)))
+    return 0;
+  /* a change in the second the index was built may not be in it */
+  if (PubringIndex && stamp < PubringBuilt &&
+      !mutt_strcmp (PubringCommand, PgpListPubringCommand))
+    return 1;
+
+  pgp_forget_pubring ();
+  now = time (NULL);
+  if (!(PubringKeys = pgp_get_candidates (PGP_PUBRING, NULL)))
+    return 0;
+
+  for (n = 0, k = PubringKeys; k; k = k->next)
+    n++;
+  PubringIndex = hash_create (MAX (n, 16), 1);
+  PubringBuilt = now;
+  PubringCommand = safe_strdup (PgpListPubringCommand);
+
+  for (k = PubringKeys; k; k = k->next)
+  {
+    if (k->flags & KEYFLAG_SUBKEY)
+      continue;
+    for (q = k->address; q; q = q->next)
+    {
+      r = rfc822_parse_adrlist (NULL, NONULL (q->addr));
+      for (p = r; p; p = p->next)
+      {
+	pgp_pubring_index_add (p->mailbox, k);
+	pgp_pubring_index_add (p->personal, k);
+      }
+      rfc822_free_address (&r);
+    }
+  }
+
+  return 1;
+}
+
+/* Copy a principal key along with its subkeys. */
+static pgp_key_t pgp_copy_key_chain (pgp_key_t k)
+{
+  pgp_key_t copy = NULL, *last = &copy, p, c;
+
+  for (p = k; p && (p == k || p->parent == k); p = p->next)
+  {
+    c = safe_calloc (1, sizeof (*c));
+    c->keyid       = safe_strdup (p->keyid);
+    c->fingerprint = safe_strdup (p->fingerprint);
+    c->flags       = p->flags;
+    c->keylen      = p->keylen;
+    c->gen_time    = p->gen_time;
+    c->numalg      = p->numalg;
+    c->algorithm   = p->algorithm;
+    c->parent      = (p == k) ? NULL : copy;
+    c->address     = pgp_copy_uids (p->address, c);
+    *last = c;
+    last = &c->next;
+  }
+
+  return copy;
+}
+
+static void pgp_pubring_collect (const char *name, pgp_key_t **found,
+				 int *nfound, int *maxfound)
+{
+  struct hash_elem *e;
+  int i;
+
+  if (!name || !*name)
+    return;
+
+  for (e = hash_find_all (PubringIndex, name, NULL); e;
+       e = hash_find_all (PubringIndex, name, e))
+  {
+    for (i = 0; i < *nfound; i++)
+      if ((*found)[i] == (pgp_key_t) e->data)
+	break;
+    if (i < *nfound)
+      continue;
+    if (*nfound == *maxfound)
+      safe_realloc (found, (*maxfound += 8) * sizeof (pgp_key_t));
+    (*found)[(*nfound)++] = e->data;
+  }
+}
+
+/* The keys a user id of which has a's mailbox or name, in keyring order. */
+static pgp_key_t pgp_pubring_candidates (ADDRESS *a)
+{
+  pgp_key_t *found = NULL, keys = NULL, *last = &keys, k;
+  int nfound = 0, maxfound = 0, i;
+
+  pgp_pubring_collect (a->mailbox, &found, &nfound, &maxfound);
+  pgp_pubring_collect (a->personal, &found, &nfound, &maxfound);
+
+  for (k = PubringKeys; k && nfound; k = k->next)
+  {
+    for (i = 0; i < nfound; i++)
+      if (found[i] == k)
+	break;
+    if (i == nfound)
+      continue;
+
+    *last = pgp_copy_key_chain (k);
+    last = pgp_get_lastp (*last);
+    found[i] = found[--nfound];
+  }
+
+  FREE (&found);
+  return keys;
+}
+
 pgp_key_t pgp_getkeybyaddr (ADDRESS * a, short abilities, pgp_ring_t keyring,
                             int oppenc_mode)
 {
@@ -829,16 +988,22 @@ pgp_key_t pgp_getkeybyaddr (ADDRESS * a, short abilities, pgp_ring_t keyring,
   pgp_key_t *last = &matches;
   pgp_uid_t *q;
 
-  if (a && a->mailbox)
-    hints = pgp_add_string_to_hints (hints, a->mailbox);
-  if (a && a->personal)
-    hints = pgp_add_string_to_hints (hints, a->personal);
-
   if (! oppenc_mode )
     mutt_message (_("Looking for keys matching \"%s\"..."), a->mailbox);
-  keys = pgp_get_candidates (keyring, hints);
 
-  mutt_free_list (&hints);
+  if (keyring == PGP_PUBRING && pgp_pubring_index ())
+    keys = pgp_pubring_candidates (a);
+  else
+  {
+    if (a && a->mailbox)
+      hints = pgp_add_string_to_hints (hints, a->mailbox);
+    if (a && a->personal)
+      hints = pgp_add_string_to_hints (hints, a->personal);
+
+    keys = pgp_get_candidates (keyring, hints);
+
+    mutt_free_list (&hints);
+  }
 
   if (!keys)
     return NULL;
@@ -40,14 +40,14 @@
 static unsigned char *pbuf = NULL;
 static size_t plen = 0;
 
-static int read_material (size_t material, size_t * used, FILE * fp)
+static int grow_material (size_t material, size_t used)
 {
-  if (*used + material >= plen)
+  if (used + material >= plen)
   {
     unsigned char *p;
     size_t nplen;
 
-    nplen = *used + material + CHUNKSIZE;
+    nplen = used + material + CHUNKSIZE;
 
     if (!(p = realloc (pbuf, nplen)))	/* __MEM_CHECKED__ */
     {
@@ -58,6 +58,14 @@ static int read_material (size_t material, size_t * used, FILE * fp)
     pbuf = p;
   }
 
+  return 0;
+}
+
+static int read_material (size_t material, size_t * used, FILE * fp)
+{
+  if (grow_material (material, *used) == -1)
+    return -1;
+
   if (fread (pbuf + *used, 1, material, fp) < material)
   {
     perror ("fread");
@@ -223,6 +231,155 @@ bail:
   return NULL;
 }
 
+/*
+ * The same for a key ring which has been mapped into memory: buf holds
+ * buflen bytes, and *off is the offset of the packet to look at.  On
+ * success, *off is moved past the packet.
+ */
+
+static int mem_material (const unsigned char *buf, size_t buflen, size_t *pos,
+			 size_t material, size_t *used, int copy)
+{
+  if (material > buflen - *pos)
+    return -1;
+
+  if (copy)
+  {
+    if (grow_material (material, *used) == -1)
+      return -1;
+    memcpy (pbuf + *used, buf + *pos, material);
+  }
+
+  *used += material;
+  *pos += material;
+  return 0;
+}
+
+/* Returns the packet's tag, or -1 at the end of the key ring.  If copy
+ * is set, the packet is collected into pbuf in the same form as
+ * pgp_read_packet() returns it. */
+static int walk_packet (const unsigned char *buf, size_t buflen, size_t *off,
+			size_t *len, int copy)
+{
+  size_t pos = *off;
+  size_t used = 0;
+  size_t material;
+  unsigned char ctb;
+  unsigned char b;
+  int tag;
+
+  if (copy && !plen)
+  {
+    plen = CHUNKSIZE;
+    pbuf = safe_malloc (plen);
+  }
+
+  if (pos >= buflen)
+    return -1;
+
+  ctb = buf[pos++];
+  if (!(ctb & 0x80))
+    return -1;
+
+  if (ctb & 0x40)		/* handle PGP 5.0 packets. */
+  {
+    int partial = 0;
+
+    tag = ctb & 0x3f;
+    if (copy)
+      pbuf[0] = ctb;
+    used++;
+
+    do
+    {
+      if (pos >= buflen)
+	return -1;
+      b = buf[pos++];
+
+      if (b < 192)
+      {
+	material = b;
+	partial = 0;
+      }
+      else if (192 <= b && b <= 223)
+      {
+	if (pos >= buflen)
+	  return -1;
+	material = (b - 192) * 256 + buf[pos++] + 192;
+	partial = 0;
+      }
+      else if (b < 255)
+      {
+	material = 1 << (b & 0x1f);
+	partial = 1;
+      }
+      else
+	/* b == 255 */
+      {
+	if (buflen - pos < 4)
+	  return -1;
+	material = buf[pos] << 24;
+	material |= buf[pos + 1] << 16;
+	material |= buf[pos + 2] << 8;
+	material |= buf[pos + 3];
+	pos += 4;
+	partial = 0;
+      }
+
+      if (mem_material (buf, buflen, &pos, material, &used, copy) == -1)
+	return -1;
+    }
+    while (partial);
+  }
+  else
+    /* Old-Style PGP */
+  {
+    int bytes;
+
+    tag = (ctb >> 2) & 0x0f;
+    if (copy)
+      pbuf[0] = 0x80 | tag;
+    used++;
+
+    switch (ctb & 0x03)
+    {
+      case 0: bytes = 1; break;
+      case 1: bytes = 2; break;
+      case 2: bytes = 4; break;
+      default: return -1;
+    }
+
+    if (buflen - pos < (size_t) bytes)
+      return -1;
+    for (material = 0; bytes > 0; bytes--)
+      material = (material << 8) + buf[pos++];
+
+    if (mem_material (buf, buflen, &pos, material, &used, copy) == -1)
+      return -1;
+  }
+
+  *off = pos;
+  if (len)
+    *len = used;
+
+  return tag;
+}
+
+unsigned char *pgp_read_packet_mem (const unsigned char *buf, size_t buflen,
+				    size_t *off, size_t *len)
+{
+  if (walk_packet (buf, buflen, off, len, 1) == -1)
+    return NULL;
+
+  return pbuf;
+}
+
+/* Step over a packet without copying it; returns its tag or -1. */
+int pgp_skip_packet_mem (const unsigned char *buf, size_t buflen, size_t *off)
+{
+  return walk_packet (buf, buflen, off, NULL, 0);
+}
+
 void pgp_release_packet (void)
 {
   plen = 0;
@@ -47,6 +47,9 @@ enum packet_tags
 };
 
 unsigned char *pgp_read_packet (FILE * fp, size_t * len);
+unsigned char *pgp_read_packet_mem (const unsigned char *buf, size_t buflen,
+				    size_t *off, size_t *len);
+int pgp_skip_packet_mem (const unsigned char *buf, size_t buflen, size_t *off);
 void pgp_release_packet (void);
 
 #endif
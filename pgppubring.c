@@ -47,6 +47,11 @@
 # include <getopt.h>
 #endif
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+#endif
 
 extern char *optarg;
 extern int optind;
@@ -59,14 +64,6 @@ extern int optind;
 
 #define MD5_DIGEST_LENGTH  16
 
-#ifdef HAVE_FGETPOS
-#define FGETPOS(fp,pos) fgetpos((fp),&(pos))
-#define FSETPOS(fp,pos) fsetpos((fp),&(pos))
-#else
-#define FGETPOS(fp,pos) pos=ftello((fp));
-#define FSETPOS(fp,pos) fseeko((fp),(pos),SEEK_SET)
-#endif
-
 
 static short dump_signatures = 0;
 static short dump_fingerprints = 0;
@@ -595,19 +592,15 @@ static int pgp_parse_sig (unsigned char *buff, size_t l,
 
 /* parse one key block, including all subkeys. */
 
-static pgp_key_t pgp_parse_keyblock (FILE * fp)
+static pgp_key_t pgp_parse_keyblock (const unsigned char *ring, size_t ringlen,
+				     size_t *off)
 {
   unsigned char *buff;
   unsigned char pt = 0;
   unsigned char last_pt;
   size_t l;
   short err = 0;
-
-#ifdef HAVE_FGETPOS
-  fpos_t pos;
-#else
-  LOFF_T pos;
-#endif
+  size_t pos;
 
   pgp_key_t root = NULL;
   pgp_key_t *last = &root;
@@ -616,9 +609,9 @@ static pgp_key_t pgp_parse_keyblock (FILE * fp)
   pgp_uid_t **addr = NULL;
   pgp_sig_t **lsig = NULL;
 
-  FGETPOS(fp,pos);
+  pos = *off;
   
-  while (!err && (buff = pgp_read_packet (fp, &l)) != NULL)
+  while (!err && (buff = pgp_read_packet_mem (ring, ringlen, off, &l)) != NULL)
   {
     last_pt = pt;
     pt = buff[0] & 0x3f;
@@ -627,7 +620,7 @@ static pgp_key_t pgp_parse_keyblock (FILE * fp)
     
     if ((pt == PT_SECKEY || pt == PT_PUBKEY) && root)
     {
-      FSETPOS(fp, pos);
+      *off = pos;
       return root;
     }
     
@@ -727,7 +720,7 @@ static pgp_key_t pgp_parse_keyblock (FILE * fp)
       }
     }
 
-    FGETPOS(fp,pos);
+    pos = *off;
   }
 
   if (err)
@@ -752,57 +745,120 @@ static int pgpring_string_matches_hint (const char *s, const char *hints[], int
   return 0;
 }
 
-/* 
- * Go through the key ring file and look for keys with
- * matching IDs.
+/*
+ * Map the key ring into memory, or read it in where it can't be
+ * mapped.  Returns NULL for an empty or unreadable key ring.
  */
 
-static void pgpring_find_candidates (char *ringfile, const char *hints[], int nhints)
+static unsigned char *pgpring_map (const char *ringfile, size_t *len, int *mapped)
 {
-  FILE *rfp;
-#ifdef HAVE_FGETPOS
-  fpos_t pos, keypos;
-#else
-  LOFF_T pos, keypos;
-#endif
+  struct stat st;
+  unsigned char *ring = NULL;
+  size_t got;
+  ssize_t r;
+  int fd;
 
-  unsigned char *buff = NULL;
-  unsigned char pt = 0;
-  size_t l = 0;
+  *mapped = 0;
 
-  short err = 0;
-  
-  if ((rfp = fopen (ringfile, "r")) == NULL)
+  if ((fd = open (ringfile, O_RDONLY)) == -1 || fstat (fd, &st) == -1)
   {
     char *error_buf;
     size_t error_buf_len;
 
-    error_buf_len = sizeof ("fopen: ") - 1 + strlen (ringfile) + 1;
+    error_buf_len = sizeof ("open: ") - 1 + strlen (ringfile) + 1;
     error_buf = safe_malloc (error_buf_len);
-    snprintf (error_buf, error_buf_len, "fopen: %s", ringfile);
+    snprintf (error_buf, error_buf_len, "open: %s", ringfile);
     perror (error_buf);
     FREE (&error_buf);
+    if (fd != -1)
+      close (fd);
+    return NULL;
+  }
+
+  if ((*len = st.st_size) == 0)
+  {
+    close (fd);
+    return NULL;
+  }
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  ring = mmap (NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ring != MAP_FAILED)
+  {
+    *mapped = 1;
+    close (fd);
+    return ring;
+  }
+  ring = NULL;
+#endif
+
+  ring = safe_malloc (*len);
+  for (got = 0; got < *len; got += r)
+  {
+    if ((r = read (fd, ring + got, *len - got)) <= 0)
+    {
+      if (r < 0)
+	perror ("read");
+      break;
+    }
+  }
+  *len = got;
+
+  close (fd);
+  return ring;
+}
+
+static void pgpring_unmap (unsigned char **ring, size_t len, int mapped)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+  if (mapped)
+  {
+    munmap (*ring, len);
+    *ring = NULL;
     return;
   }
+#endif
+  FREE (ring);		/* __FREE_CHECKED__ */
+}
+
+/* 
+ * Go through the key ring file and look for keys with
+ * matching IDs.  Only the user ID packets are copied out of the
+ * key ring; everything else is merely stepped over until a key
+ * block needs to be dumped.
+ */
+
+static void pgpring_find_candidates (char *ringfile, const char *hints[], int nhints)
+{
+  unsigned char *ring;
+  size_t ringlen;
+  int mapped;
+  size_t off = 0, pos = 0, keypos = 0;
 
-  FGETPOS(rfp,pos);
-  FGETPOS(rfp,keypos);
+  unsigned char *buff = NULL;
+  int pt;
+  size_t l = 0;
+
+  short err = 0;
+  
+  if ((ring = pgpring_map (ringfile, &ringlen, &mapped)) == NULL)
+    return;
 
-  while (!err && (buff = pgp_read_packet (rfp, &l)) != NULL)
+  while (!err && (pt = pgp_skip_packet_mem (ring, ringlen, &off)) != -1)
   {
-    pt = buff[0] & 0x3f;
-    
-    if (l < 1)
-      continue;
-    
     if ((pt == PT_SECKEY) || (pt == PT_PUBKEY))
     {
       keypos = pos;
     }
     else if (pt == PT_NAME)
     {
-      char *tmp = safe_malloc (l);
+      char *tmp;
+      size_t namepos = pos;
 
+      if ((buff = pgp_read_packet_mem (ring, ringlen, &namepos, &l)) == NULL)
+	break;
+
+      tmp = safe_malloc (l);
       memcpy (tmp, buff + 1, l - 1);
       tmp[l - 1] = '\0';
 
@@ -812,11 +868,11 @@ static void pgpring_find_candidates (char *ringfile, const char *hints[], int nh
       {
 	pgp_key_t p;
 
-	FSETPOS(rfp, keypos);
+	off = keypos;
 
 	/* Not bailing out here would lead us into an endless loop. */
 
-	if ((p = pgp_parse_keyblock (rfp)) == NULL)
+	if ((p = pgp_parse_keyblock (ring, ringlen, &off)) == NULL)
 	  err = 1;
 	
 	pgpring_dump_keyblock (p);
@@ -826,11 +882,10 @@ static void pgpring_find_candidates (char *ringfile, const char *hints[], int nh
       FREE (&tmp);
     }
 
-    FGETPOS(rfp,pos);
+    pos = off;
   }
 
-  safe_fclose (&rfp);
-
+  pgpring_unmap (&ring, ringlen, mapped);
 }
 
 static void print_userid (const char *id)
@@ -40,6 +40,19 @@
 #define HC_FEXT		"hcache"	/* extension for hcache as POP lacks paths */
 #endif
 
+/* bcache id suffix marking messages delivered by pop_fetch_mail() */
+#define POP_FETCHED	".fetched"
+
+/* what pop_fetch_mail() has to do with a message */
+enum
+{
+  POP_FETCH_RETR = 0,	/* download it */
+  POP_FETCH_CACHED,	/* deliver it from the body cache */
+  POP_FETCH_DELIVERED,	/* delivered by an earlier run, only delete it */
+  POP_FETCH_DONE,	/* delivered */
+  POP_FETCH_DELETED	/* delivered and deleted on the server */
+};
+
 /* write line to file */
 static int fetch_message (char *line, void *file)
 {
@@ -52,19 +65,25 @@ static int fetch_message (char *line, void *file)
   return 0;
 }
 
+/* drop line of a response nobody is interested in any more */
+static int skip_line (char *line, void *data)
+{
+  return 0;
+}
+
 /*
- * Read header
+ * Read header, the response to "TOP refno 0" which has been sent already;
+ * length is the size of the message from LIST.
  * returns:
  *  0 on success
  * -1 - connection lost,
  * -2 - invalid command or execution error,
  * -3 - error writing to tempfile
  */
-static int pop_read_header (POP_DATA *pop_data, HEADER *h)
+static int pop_read_header (POP_DATA *pop_data, HEADER *h, long length)
 {
   FILE *f;
-  int ret, index;
-  long length;
+  int ret;
   char buf[LONG_STRING];
   char tempfile[_POSIX_PATH_MAX];
 
@@ -72,35 +91,28 @@ static int pop_read_header (POP_DATA *pop_data, HEADER *h)
   if (!(f = safe_fopen (tempfile, "w+")))
   {
     mutt_perror (tempfile);
-    return -3;
+    ret = pop_fetch_response (pop_data, "TOP", NULL, skip_line, NULL);
+    return ret == -1 ? -1 : -3;
   }
 
-  snprintf (buf, sizeof (buf), "LIST %d\r\n", h->refno);
-  ret = pop_query (pop_data, buf, sizeof (buf));
-  if (ret == 0)
-  {
-    sscanf (buf, "+OK %d %ld", &index, &length);
+  ret = pop_fetch_response (pop_data, "TOP", NULL, fetch_message, f);
 
-    snprintf (buf, sizeof (buf), "TOP %d 0\r\n", h->refno);
-    ret = pop_fetch_data (pop_data, buf, NULL, fetch_message, f);
-
-    if (pop_data->cmd_top == 2)
+  if (pop_data->cmd_top == 2)
+  {
+    if (ret == 0)
     {
-      if (ret == 0)
-      {
-	pop_data->cmd_top = 1;
+      pop_data->cmd_top = 1;
 
-	dprint (1, (debugfile, "pop_read_header: set TOP capability\n"));
-      }
+      dprint (1, (debugfile, "pop_read_header: set TOP capability\n"));
+    }
 
-      if (ret == -2)
-      {
-	pop_data->cmd_top = 0;
+    if (ret == -2)
+    {
+      pop_data->cmd_top = 0;
 
-	dprint (1, (debugfile, "pop_read_header: unset TOP capability\n"));
-	snprintf (pop_data->err_msg, sizeof (pop_data->err_msg),
-		_("Command TOP is not supported by server."));
-      }
+      dprint (1, (debugfile, "pop_read_header: unset TOP capability\n"));
+      snprintf (pop_data->err_msg, sizeof (pop_data->err_msg),
+	      _("Command TOP is not supported by server."));
     }
   }
 
@@ -136,12 +148,20 @@ static int pop_read_header (POP_DATA *pop_data, HEADER *h)
   return ret;
 }
 
+struct uidl_data
+{
+  CONTEXT *ctx;
+  HASH *uidls;		/* headers of ctx by UIDL */
+};
+
 /* parse UIDL */
 static int fetch_uidl (char *line, void *data)
 {
   int i, index;
-  CONTEXT *ctx = (CONTEXT *)data;
+  struct uidl_data *ud = (struct uidl_data *)data;
+  CONTEXT *ctx = ud->ctx;
   POP_DATA *pop_data = (POP_DATA *)ctx->data;
+  HEADER *h;
   char *endp;
 
   errno = 0;
@@ -152,39 +172,48 @@ static int fetch_uidl (char *line, void *data)
       endp++;
   memmove(line, endp, strlen(endp) + 1);
 
-  for (i = 0; i < ctx->msgcount; i++)
-    if (!mutt_strcmp (line, ctx->hdrs[i]->data))
-      break;
-
-  if (i == ctx->msgcount)
+  if (!(h = hash_find (ud->uidls, line)))
   {
     dprint (1, (debugfile, "pop_fetch_headers: new header %d %s\n", index, line));
 
+    i = ctx->msgcount;
     if (i >= ctx->hdrmax)
       mx_alloc_memory(ctx);
 
     ctx->msgcount++;
-    ctx->hdrs[i] = mutt_new_header ();
-    ctx->hdrs[i]->data = safe_strdup (line);
+    h = ctx->hdrs[i] = mutt_new_header ();
+    h->data = safe_strdup (line);
+    hash_insert (ud->uidls, h->data, h, 0);
   }
-  else if (ctx->hdrs[i]->index != index - 1)
+  else if (h->index != index - 1)
     pop_data->clear_cache = 1;
 
-  ctx->hdrs[i]->refno = index;
-  ctx->hdrs[i]->index = index - 1;
+  h->refno = index;
+  h->index = index - 1;
+
+  return 0;
+}
+
+/* parse LIST, the sizes of the messages */
+static int fetch_list (char *line, void *data)
+{
+  long *sizes = (long *)data;
+  int index;
+  long length;
+
+  if (sscanf (line, "%d %ld", &index, &length) == 2 &&
+      index > 0 && index <= sizes[0] && length >= 0)
+    sizes[index] = length;
 
   return 0;
 }
 
 static int msg_cache_check (const char *id, body_cache_t *bcache, void *data)
 {
-  CONTEXT *ctx;
-  POP_DATA *pop_data;
-  int i;
+  HASH *uidls;
+  size_t len;
 
-  if (!(ctx = (CONTEXT *)data))
-    return -1;
-  if (!(pop_data = (POP_DATA *)ctx->data))
+  if (!(uidls = (HASH *)data))
     return -1;
 
 #ifdef USE_HCACHE
@@ -193,10 +222,21 @@ static int msg_cache_check (const char *id, body_cache_t *bcache, void *data)
     return 0;
 #endif
 
-  for (i = 0; i < ctx->msgcount; i++)
-    /* if the id we get is known for a header: done (i.e. keep in cache) */
-    if (ctx->hdrs[i]->data && mutt_strcmp (ctx->hdrs[i]->data, id) == 0)
+  /* if the id we get is known for a header: done (i.e. keep in cache) */
+  if (hash_find (uidls, id))
+    return 0;
+
+  /* same for the markers of pop_fetch_mail() */
+  if ((len = mutt_strlen (id)) > sizeof (POP_FETCHED) - 1 &&
+      !strcmp (id + len - (sizeof (POP_FETCHED) - 1), POP_FETCHED))
+  {
+    char *uidl = mutt_substrdup (id, id + len - (sizeof (POP_FETCHED) - 1));
+    int known = hash_find (uidls, uidl) != NULL;
+
+    FREE (&uidl);
+    if (known)
       return 0;
+  }
 
   /* message not found in context -> remove it from cache
    * return the result of bcache, so we stop upon its first error
@@ -235,9 +275,13 @@ static header_cache_t *pop_hcache_open (POP_DATA *pop_data, const char *path)
  */
 static int pop_fetch_headers (CONTEXT *ctx)
 {
-  int i, ret, old_count, new_count, deleted;
-  unsigned short hcached = 0, bcached;
+  int i, j, ret, old_count, new_count, deleted, depth, inflight;
+  unsigned short bcached;
+  char *hcached = NULL;
+  long *sizes = NULL;
+  char buf[SHORT_STRING];
   POP_DATA *pop_data = (POP_DATA *)ctx->data;
+  struct uidl_data ud;
   progress_t progress;
 
 #ifdef USE_HCACHE
@@ -254,7 +298,10 @@ static int pop_fetch_headers (CONTEXT *ctx)
     ctx->hdrs[i]->refno = -1;
 
   old_count = ctx->msgcount;
-  ret = pop_fetch_data (pop_data, "UIDL\r\n", NULL, fetch_uidl, ctx);
+  ud.ctx = ctx;
+  ud.uidls = pop_uidl_hash (ctx);
+  ret = pop_fetch_data (pop_data, "UIDL\r\n", NULL, fetch_uidl, &ud);
+  hash_destroy (&ud.uidls, NULL);
   new_count = ctx->msgcount;
   ctx->msgcount = old_count;
 
@@ -298,10 +345,13 @@ static int pop_fetch_headers (CONTEXT *ctx)
       mutt_sleep (2);
     }
 
-    for (i = old_count; i < new_count; i++)
+    /*
+     * restore what we can from the header cache first, so that the
+     * remaining headers can be requested from the server in one go
+     */
+    hcached = safe_calloc (new_count - old_count + 1, sizeof (char));
+    for (i = old_count, j = 0; i < new_count; i++)
     {
-      if (!ctx->quiet)
-	mutt_progress_update (&progress, i + 1 - old_count, -1);
 #if USE_HCACHE
       if ((data = mutt_hcache_fetch (hc, ctx->hdrs[i]->data, strlen)))
       {
@@ -323,21 +373,78 @@ static int pop_fetch_headers (CONTEXT *ctx)
 	ctx->hdrs[i]->refno = refno;
 	ctx->hdrs[i]->index = index;
 	ctx->hdrs[i]->data = uidl;
-	ret = 0;
-	hcached = 1;
+	hcached[i - old_count] = 1;
+	FREE (&data);
+	continue;
       }
-      else
 #endif
-      if ((ret = pop_read_header (pop_data, ctx->hdrs[i])) < 0)
-	break;
-#if USE_HCACHE
-      else
+      if (ctx->hdrs[i]->refno > j)
+	j = ctx->hdrs[i]->refno;
+    }
+
+    /* a single LIST instead of one per message for the message sizes */
+    if (j > 0)
+    {
+      sizes = safe_malloc ((j + 1) * sizeof (long));
+      sizes[0] = j;
+      while (j > 0)
+	sizes[j--] = -1;
+      ret = pop_fetch_data (pop_data, "LIST\r\n", NULL, fetch_list, sizes);
+
+      /* ask for those the server left out of the listing one by one */
+      for (i = old_count; ret == 0 && i < new_count; i++)
       {
-	mutt_hcache_store (hc, ctx->hdrs[i]->data, ctx->hdrs[i], 0, strlen, M_GENERATE_UIDVALIDITY);
+	if (hcached[i - old_count] || sizes[ctx->hdrs[i]->refno] >= 0)
+	  continue;
+	snprintf (buf, sizeof (buf), "LIST %d\r\n", ctx->hdrs[i]->refno);
+	if ((ret = pop_query (pop_data, buf, sizeof (buf))) == 0 &&
+	    (sscanf (buf, "+OK %d %ld", &j, &sizes[ctx->hdrs[i]->refno]) != 2 ||
+	     sizes[ctx->hdrs[i]->refno] < 0))
+	{
+	  snprintf (pop_data->err_msg, sizeof (pop_data->err_msg),
+		    _("Can't get the size of message %d."), ctx->hdrs[i]->refno);
+	  ret = -2;
+	}
+      }
+      if (ret == -2)
+	mutt_error ("%s", pop_data->err_msg);
+    }
+
+    /*
+     * the TOP commands are sent in batches if the server supports
+     * PIPELINING, the first one alone as long as we don't know whether
+     * TOP works at all
+     */
+    depth = pop_data->cmd_top == 2 ? 1 : pop_pipeline_depth (pop_data);
+    for (i = old_count, j = old_count, inflight = 0; ret == 0 && i < new_count; i++)
+    {
+      for (; j < new_count && inflight < depth; j++)
+      {
+	if (hcached[j - old_count])
+	  continue;
+	snprintf (buf, sizeof (buf), "TOP %d 0\r\n", ctx->hdrs[j]->refno);
+	if ((ret = pop_send (pop_data, buf)) < 0)
+	  break;
+	inflight++;
       }
+      if (ret < 0)
+	break;
+
+      if (!ctx->quiet)
+	mutt_progress_update (&progress, i + 1 - old_count, -1);
 
-      FREE(&data);
+      if (!hcached[i - old_count])
+      {
+	inflight--;
+	ret = pop_read_header (pop_data, ctx->hdrs[i], sizes[ctx->hdrs[i]->refno]);
+	if (ret < 0)
+	  break;
+#if USE_HCACHE
+	mutt_hcache_store (hc, ctx->hdrs[i]->data, ctx->hdrs[i], 0, strlen, M_GENERATE_UIDVALIDITY);
 #endif
+	if (pop_data->cmd_top == 1)
+	  depth = pop_pipeline_depth (pop_data);
+      }
 
       /*
        * faked support for flags works like this:
@@ -354,7 +461,7 @@ static int pop_fetch_headers (CONTEXT *ctx)
       bcached = mutt_bcache_exists (pop_data->bcache, ctx->hdrs[i]->data) == 0;
       ctx->hdrs[i]->old = 0;
       ctx->hdrs[i]->read = 0;
-      if (hcached)
+      if (hcached[i - old_count])
       {
         if (bcached)
           ctx->hdrs[i]->read = 1;
@@ -370,10 +477,17 @@ static int pop_fetch_headers (CONTEXT *ctx)
       ctx->msgcount++;
     }
 
+    /* the responses to commands still in flight have to be read anyway */
+    while (inflight-- > 0 && pop_data->status == POP_CONNECTED)
+      pop_fetch_response (pop_data, "TOP", NULL, skip_line, NULL);
+
     if (i > old_count)
       mx_update_context (ctx, i - old_count);
   }
 
+  FREE (&hcached);
+  FREE (&sizes);
+
 #if USE_HCACHE
     mutt_hcache_close (hc);
 #endif
@@ -390,7 +504,11 @@ static int pop_fetch_headers (CONTEXT *ctx)
    * the availability of our cache
    */
   if (option (OPTMESSAGECACHECLEAN))
-    mutt_bcache_list (pop_data->bcache, msg_cache_check, (void*)ctx);
+  {
+    ud.uidls = pop_uidl_hash (ctx);
+    mutt_bcache_list (pop_data->bcache, msg_cache_check, ud.uidls);
+    hash_destroy (&ud.uidls, NULL);
+  }
 
   mutt_clear_error ();
   return (new_count - old_count);
@@ -660,7 +778,7 @@ int pop_fetch_message (MESSAGE* msg, CONTEXT* ctx, int msgno)
 /* update POP mailbox - delete messages from server */
 int pop_sync_mailbox (CONTEXT *ctx, int *index_hint)
 {
-  int i, j, ret = 0;
+  int i, j, k, ret = 0, depth, inflight;
   char buf[LONG_STRING];
   POP_DATA *pop_data = (POP_DATA *)ctx->data;
   progress_t progress;
@@ -682,15 +800,29 @@ int pop_sync_mailbox (CONTEXT *ctx, int *index_hint)
     hc = pop_hcache_open (pop_data, ctx->path);
 #endif
 
-    for (i = 0, j = 0, ret = 0; ret == 0 && i < ctx->msgcount; i++)
+    /* with PIPELINING, keep up to depth DELE commands in flight */
+    depth = pop_pipeline_depth (pop_data);
+    for (i = 0, j = 0, k = 0, inflight = 0, ret = 0; ret == 0 && i < ctx->msgcount; i++)
     {
+      for (; k < ctx->msgcount && inflight < depth; k++)
+      {
+	if (!ctx->hdrs[k]->deleted || ctx->hdrs[k]->refno == -1)
+	  continue;
+	snprintf (buf, sizeof (buf), "DELE %d\r\n", ctx->hdrs[k]->refno);
+	if ((ret = pop_send (pop_data, buf)) < 0)
+	  break;
+	inflight++;
+      }
+      if (ret < 0)
+	break;
+
       if (ctx->hdrs[i]->deleted && ctx->hdrs[i]->refno != -1)
       {
 	j++;
+	inflight--;
 	if (!ctx->quiet)
 	  mutt_progress_update (&progress, j, -1);
-	snprintf (buf, sizeof (buf), "DELE %d\r\n", ctx->hdrs[i]->refno);
-	if ((ret = pop_query (pop_data, buf, sizeof (buf))) == 0)
+	if ((ret = pop_read_response (pop_data, "DELE", buf, sizeof (buf))) == 0)
 	{
 	  mutt_bcache_del (pop_data->bcache, ctx->hdrs[i]->data);
 #if USE_HCACHE
@@ -708,6 +840,10 @@ int pop_sync_mailbox (CONTEXT *ctx, int *index_hint)
 
     }
 
+    /* skip the responses still in flight after an error */
+    while (inflight-- > 0 && pop_data->status == POP_CONNECTED)
+      pop_read_response (pop_data, "DELE", buf, sizeof (buf));
+
 #if USE_HCACHE
     mutt_hcache_close (hc);
 #endif
@@ -767,13 +903,59 @@ int pop_check_mailbox (CONTEXT *ctx, int *index_hint)
   return 0;
 }
 
+struct uidl_list
+{
+  char **uids;		/* UIDLs by message number */
+  int msgs;
+};
+
+static void pop_free_fetch (char **state, char ***uids, int msgs,
+			    body_cache_t **bcache)
+{
+  int i;
+
+  if (*uids)
+  {
+    for (i = 0; i <= msgs; i++)
+      FREE (&(*uids)[i]);
+    FREE (uids);		/* __FREE_CHECKED__ */
+  }
+  FREE (state);		/* __FREE_CHECKED__ */
+  mutt_bcache_close (bcache);
+}
+
+/* parse UIDL into a list */
+static int fetch_uidl_list (char *line, void *data)
+{
+  struct uidl_list *fl = (struct uidl_list *)data;
+  int index;
+  char *endp;
+
+  errno = 0;
+  index = strtol (line, &endp, 10);
+  if (errno)
+    return -1;
+  while (*endp == ' ')
+    endp++;
+
+  if (index > 0 && index <= fl->msgs && *endp)
+    mutt_str_replace (&fl->uids[index], endp);
+
+  return 0;
+}
+
 /* Fetch messages and save them in $spoolfile */
 void pop_fetch_mail (void)
 {
   char buffer[LONG_STRING];
   char msgbuf[SHORT_STRING];
   char *url, *p;
-  int i, delanswer, last = 0, msgs, bytes, rset = 0, ret;
+  int i, j, delanswer, last = 0, msgs = 0, bytes = 0, rset = 0, ret, depth, inflight;
+  char *state = NULL;
+  char **uids = NULL;
+  struct uidl_list fl;
+  body_cache_t *bcache = NULL;
+  FILE *fp;
   CONNECTION *conn;
   CONTEXT ctx;
   MESSAGE *msg = NULL;
@@ -855,34 +1037,100 @@ void pop_fetch_mail (void)
 
   delanswer = query_quadoption (OPT_POPDELETE, _("Delete messages from server?"));
 
+  /*
+   * with $message_cachedir, bodies already in the cache are not fetched
+   * again, and messages delivered by an earlier run which didn't get to
+   * delete them on the server are not delivered twice
+   */
+  state = safe_calloc (msgs + 1, sizeof (char));
+  if ((bcache = mutt_bcache_open (&acct, NULL)) && pop_data->cmd_uidl)
+  {
+    fl.msgs = msgs;
+    fl.uids = uids = safe_calloc (msgs + 1, sizeof (char *));
+    ret = pop_fetch_data (pop_data, "UIDL\r\n", NULL, fetch_uidl_list, &fl);
+    if (ret == -1)
+    {
+      mx_close_mailbox (&ctx, NULL);
+      goto fail;
+    }
+
+    for (i = last + 1; ret == 0 && i <= msgs; i++)
+    {
+      if (!uids[i])
+	continue;
+      snprintf (buffer, sizeof (buffer), "%s" POP_FETCHED, uids[i]);
+      if (delanswer == M_YES && mutt_bcache_exists (bcache, buffer) == 0)
+	state[i] = POP_FETCH_DELIVERED;
+      else if (mutt_bcache_exists (bcache, uids[i]) == 0)
+	state[i] = POP_FETCH_CACHED;
+    }
+  }
+
   snprintf (msgbuf, sizeof (msgbuf), _("Reading new messages (%d bytes)..."), bytes);
   mutt_message ("%s", msgbuf);
 
-  for (i = last + 1 ; i <= msgs ; i++)
+  /* with PIPELINING, keep up to depth RETR commands in flight */
+  depth = pop_pipeline_depth (pop_data);
+  for (i = j = last + 1, inflight = 0, ret = 0; i <= msgs; i++)
   {
-    if ((msg = mx_open_new_message (&ctx, NULL, M_ADD_FROM)) == NULL)
-      ret = -3;
-    else
+    for (; j <= msgs && inflight < depth; j++)
     {
-      snprintf (buffer, sizeof (buffer), "RETR %d\r\n", i);
-      ret = pop_fetch_data (pop_data, buffer, NULL, fetch_message, msg->fp);
-      if (ret == -3)
-	rset = 1;
+      if (state[j] != POP_FETCH_RETR)
+	continue;
+      snprintf (buffer, sizeof (buffer), "RETR %d\r\n", j);
+      if ((ret = pop_send (pop_data, buffer)) < 0)
+	break;
+      inflight++;
+    }
 
-      if (ret == 0 && mx_commit_message (msg, &ctx) != 0)
-      {
-	rset = 1;
+    if (ret == 0 && state[i] != POP_FETCH_DELIVERED)
+    {
+      if ((msg = mx_open_new_message (&ctx, NULL, M_ADD_FROM)) == NULL)
 	ret = -3;
-      }
+      else
+      {
+	if (state[i] == POP_FETCH_CACHED &&
+	    (fp = mutt_bcache_get (bcache, uids[i])))
+	{
+	  if (mutt_copy_stream (fp, msg->fp) != 0)
+	    ret = -3;
+	  safe_fclose (&fp);
+	}
+	else if (state[i] == POP_FETCH_CACHED)
+	{
+	  /* gone since, and can't be fetched out of order now */
+	  snprintf (pop_data->err_msg, sizeof (pop_data->err_msg),
+		    _("Can't read message %d from the message cache."), i);
+	  ret = -2;
+	}
+	else
+	{
+	  inflight--;
+	  ret = pop_fetch_response_file (pop_data, "RETR", msg->fp);
+	}
+	if (ret == -3)
+	  rset = 1;
 
-      mx_close_message (&msg);
-    }
+	if (ret == 0 && mx_commit_message (msg, &ctx) != 0)
+	{
+	  rset = 1;
+	  ret = -3;
+	}
 
-    if (ret == 0 && delanswer == M_YES)
-    {
-      /* delete the message on the server */
-      snprintf (buffer, sizeof (buffer), "DELE %d\r\n", i);
-      ret = pop_query (pop_data, buffer, sizeof (buffer));
+	mx_close_message (&msg);
+      }
+
+      if (ret == 0 && delanswer == M_YES && uids && uids[i])
+      {
+	/* remember the delivery until the server has deleted the message */
+	snprintf (buffer, sizeof (buffer), "%s" POP_FETCHED, uids[i]);
+	if ((fp = mutt_bcache_put (bcache, buffer, 0)))
+	{
+	  /* mutt_bcache_exists() ignores empty files */
+	  fprintf (fp, "%s\n", uids[i]);
+	  safe_fclose (&fp);
+	}
+      }
     }
 
     if (ret == -1)
@@ -901,11 +1149,17 @@ void pop_fetch_mail (void)
       break;
     }
 
+    state[i] = POP_FETCH_DONE;
     mutt_message (_("%s [%d of %d messages read]"), msgbuf, i - last, msgs - last);
   }
 
   mx_close_mailbox (&ctx, NULL);
 
+  /* the responses to commands still in flight have to be read anyway */
+  while (inflight-- > 0)
+    if (pop_fetch_response (pop_data, "RETR", NULL, skip_line, NULL) == -1)
+      goto fail;
+
   if (rset)
   {
     /* make sure no messages get deleted */
@@ -913,18 +1167,71 @@ void pop_fetch_mail (void)
     if (pop_query (pop_data, buffer, sizeof (buffer)) == -1)
       goto fail;
   }
+  else if (delanswer == M_YES)
+  {
+    /* delete the messages on the server, depth DELE commands at a time */
+    for (i = j = last + 1, inflight = 0, ret = 0; ret == 0 && i <= msgs; i++)
+    {
+      for (; j <= msgs && inflight < depth; j++)
+      {
+	if (state[j] != POP_FETCH_DONE)
+	  continue;
+	snprintf (buffer, sizeof (buffer), "DELE %d\r\n", j);
+	if ((ret = pop_send (pop_data, buffer)) < 0)
+	  break;
+	inflight++;
+      }
+      if (ret == 0 && state[i] == POP_FETCH_DONE)
+      {
+	inflight--;
+	if ((ret = pop_read_response (pop_data, "DELE", buffer, sizeof (buffer))) == 0)
+	  state[i] = POP_FETCH_DELETED;
+      }
+    }
+    while (ret != -1 && inflight-- > 0)
+      ret = pop_read_response (pop_data, "DELE", buffer, sizeof (buffer));
+    if (ret == -1)
+      goto fail;
+    if (ret == -2)
+      mutt_error ("%s", pop_data->err_msg);
+
+    /* the deletions only take effect with a successful QUIT; otherwise
+     * the messages are still on the server and have to be recognized as
+     * delivered next time */
+    strfcpy (buffer, "QUIT\r\n", sizeof (buffer));
+    if ((ret = pop_query (pop_data, buffer, sizeof (buffer))) == -1)
+      goto fail;
+    if (ret == -2)
+    {
+      mutt_error ("%s", pop_data->err_msg);
+      goto done;
+    }
+    for (i = last + 1; uids && i <= msgs; i++)
+    {
+      if (state[i] != POP_FETCH_DELETED || !uids[i])
+	continue;
+      mutt_bcache_del (bcache, uids[i]);
+      snprintf (buffer, sizeof (buffer), "%s" POP_FETCHED, uids[i]);
+      mutt_bcache_del (bcache, buffer);
+    }
+    goto done;
+  }
 
 finish:
   /* exit gracefully */
   strfcpy (buffer, "QUIT\r\n", sizeof (buffer));
   if (pop_query (pop_data, buffer, sizeof (buffer)) == -1)
     goto fail;
+
+done:
   mutt_socket_close (conn);
   FREE (&pop_data);
+  pop_free_fetch (&state, &uids, msgs, &bcache);
   return;
 
 fail:
   mutt_error _("Server closed connection!");
   mutt_socket_close (conn);
   FREE (&pop_data);
+  pop_free_fetch (&state, &uids, msgs, &bcache);
 }
@@ -33,6 +33,9 @@
 /* maximal length of the server response (RFC1939) */
 #define POP_CMD_RESPONSE 512
 
+/* commands sent ahead of their responses if the server supports PIPELINING */
+#define POP_PIPELINE_DEPTH 32
+
 enum
 {
   /* Status */
@@ -67,6 +70,7 @@ typedef struct
   unsigned int cmd_user : 2;	/* optional command USER */
   unsigned int cmd_uidl : 2;	/* optional command UIDL */
   unsigned int cmd_top : 2;	/* optional command TOP */
+  unsigned int cmd_pipelining : 1;	/* PIPELINING capability (RFC2449) */
   unsigned int resp_codes : 1;	/* server supports extended response codes */
   unsigned int expire : 1;	/* expire is greater than 0 */
   unsigned int clear_cache : 1;
@@ -99,7 +103,13 @@ int pop_parse_path (const char *, ACCOUNT *);
 int pop_connect (POP_DATA *);
 int pop_open_connection (POP_DATA *);
 int pop_query_d (POP_DATA *, char *, size_t, char *);
+int pop_send (POP_DATA *, const char *);
+int pop_read_response (POP_DATA *, const char *, char *, size_t);
 int pop_fetch_data (POP_DATA *, char *, progress_t *, int (*funct) (char *, void *), void *);
+int pop_fetch_response (POP_DATA *, const char *, progress_t *, int (*funct) (char *, void *), void *);
+int pop_fetch_response_file (POP_DATA *, const char *, FILE *);
+int pop_pipeline_depth (POP_DATA *);
+HASH *pop_uidl_hash (CONTEXT *);
 int pop_reconnect (CONTEXT *);
 void pop_logout (CONTEXT *);
 void pop_error (POP_DATA *, char *);
@@ -119,6 +119,9 @@ static int fetch_capa (char *line, void *data)
   else if (!ascii_strncasecmp (line, "TOP", 3))
     pop_data->cmd_top = 1;
 
+  else if (!ascii_strncasecmp (line, "PIPELINING", 10))
+    pop_data->cmd_pipelining = 1;
+
   return 0;
 }
 
@@ -165,6 +168,7 @@ static int pop_capabilities (POP_DATA *pop_data, int mode)
     pop_data->cmd_user = 0;
     pop_data->cmd_uidl = 0;
     pop_data->cmd_top = 0;
+    pop_data->cmd_pipelining = 0;
     pop_data->resp_codes = 0;
     pop_data->expire = 1;
     pop_data->login_delay = 0;
@@ -419,7 +423,7 @@ void pop_logout (CONTEXT *ctx)
 int pop_query_d (POP_DATA *pop_data, char *buf, size_t buflen, char *msg)
 {
   int dbg = M_SOCK_LOG_CMD;
-  char *c;
+  char cmd[SHORT_STRING];
 
   if (pop_data->status != POP_CONNECTED)
     return -1;
@@ -435,9 +439,43 @@ int pop_query_d (POP_DATA *pop_data, char *buf, size_t buflen, char *msg)
 
   mutt_socket_write_d (pop_data->conn, buf, -1, dbg);
 
-  c = strpbrk (buf, " \r\n");
-  *c = '\0';
-  snprintf (pop_data->err_msg, sizeof (pop_data->err_msg), "%s: ", buf);
+  strfcpy (cmd, buf, sizeof (cmd));
+  return pop_read_response (pop_data, cmd, buf, buflen);
+}
+
+/*
+ * Send one or more commands without waiting for the responses, which have
+ * to be read with pop_read_response() or pop_fetch_response() in the same
+ * order.  Several commands may only be sent at once if the server supports
+ * PIPELINING, see pop_pipeline_depth().
+ *  0 - successful,
+ * -1 - connection lost.
+*/
+int pop_send (POP_DATA *pop_data, const char *cmds)
+{
+  if (pop_data->status != POP_CONNECTED)
+    return -1;
+
+  if (mutt_socket_write (pop_data->conn, cmds) < 0)
+  {
+    pop_data->status = POP_DISCONNECTED;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * Read the status line of the response to a command sent before, cmd is
+ * used for the error message.
+ *  0 - successful,
+ * -1 - connection lost,
+ * -2 - invalid command or execution error.
+*/
+int pop_read_response (POP_DATA *pop_data, const char *cmd, char *buf, size_t buflen)
+{
+  size_t len = strcspn (cmd, " \r\n");
+
+  snprintf (pop_data->err_msg, sizeof (pop_data->err_msg), "%.*s: ", (int) len, cmd);
 
   if (mutt_socket_readln (buf, buflen, pop_data->conn) < 0)
   {
@@ -451,30 +489,23 @@ int pop_query_d (POP_DATA *pop_data, char *buf, size_t buflen, char *msg)
   return -2;
 }
 
-/*
- * This function calls  funct(*line, *data)  for each received line,
- * funct(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
- * Returned codes:
- *  0 - successful,
- * -1 - connection lost,
- * -2 - invalid command or execution error,
- * -3 - error in funct(*line, *data)
- */
-int pop_fetch_data (POP_DATA *pop_data, char *query, progress_t *progressbar,
-		    int (*funct) (char *, void *), void *data)
+/* number of commands which may be sent before reading their responses */
+int pop_pipeline_depth (POP_DATA *pop_data)
+{
+  return pop_data->cmd_pipelining ? POP_PIPELINE_DEPTH : 1;
+}
+
+/* read the lines of a multi-line response, see pop_fetch_data() */
+static int pop_read_data (POP_DATA *pop_data, progress_t *progressbar,
+			  int (*funct) (char *, void *), void *data)
 {
   char buf[LONG_STRING];
   char *inbuf;
   char *p;
-  int ret, chunk = 0;
+  int ret = 0, chunk = 0;
   long pos = 0;
   size_t lenbuf = 0;
 
-  strfcpy (buf, query, sizeof (buf));
-  ret = pop_query (pop_data, buf, sizeof (buf));
-  if (ret < 0)
-    return ret;
-
   inbuf = safe_malloc (sizeof (buf));
 
   FOREVER
@@ -519,12 +550,109 @@ int pop_fetch_data (POP_DATA *pop_data, char *query, progress_t *progressbar,
   return ret;
 }
 
+/*
+ * Like pop_fetch_data(), for the response to a command sent before with
+ * pop_send().
+ */
+int pop_fetch_response (POP_DATA *pop_data, const char *cmd, progress_t *progressbar,
+			int (*funct) (char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  int ret;
+
+  if ((ret = pop_read_response (pop_data, cmd, buf, sizeof (buf))) < 0)
+    return ret;
+  return pop_read_data (pop_data, progressbar, funct, data);
+}
+
+/*
+ * Copy the multi-line response to a command sent before with pop_send()
+ * straight into fp, without the dot-stuffing and with '\n' line endings.
+ * Returned codes are the same as for pop_fetch_data().
+ */
+int pop_fetch_response_file (POP_DATA *pop_data, const char *cmd, FILE *fp)
+{
+  char buf[LONG_STRING];
+  char *p;
+  int ret, chunk, cont = 0;
+  size_t len;
+
+  if ((ret = pop_read_response (pop_data, cmd, buf, sizeof (buf))) < 0)
+    return ret;
+
+  FOREVER
+  {
+    chunk = mutt_socket_readln_d (buf, sizeof (buf), pop_data->conn, M_SOCK_LOG_HDR);
+    if (chunk < 0)
+    {
+      pop_data->status = POP_DISCONNECTED;
+      return -1;
+    }
+
+    p = buf;
+    if (!cont && buf[0] == '.')
+    {
+      if (buf[1] != '.')
+	break;
+      p++;
+    }
+
+    /* cast is safe since we return when chunk<0 */
+    cont = (size_t)chunk >= sizeof (buf);
+    len = chunk - 1 - (p - buf);
+
+    /* keep reading after an error to stay in sync with the server */
+    if (ret == 0 && (fwrite (p, 1, len, fp) != len ||
+		     (!cont && putc ('\n', fp) == EOF)))
+      ret = -3;
+  }
+
+  return ret;
+}
+
+/*
+ * This function calls  funct(*line, *data)  for each received line,
+ * funct(NULL, *data)  if  rewind(*data)  needs, exits when fail or done.
+ * Returned codes:
+ *  0 - successful,
+ * -1 - connection lost,
+ * -2 - invalid command or execution error,
+ * -3 - error in funct(*line, *data)
+ */
+int pop_fetch_data (POP_DATA *pop_data, char *query, progress_t *progressbar,
+		    int (*funct) (char *, void *), void *data)
+{
+  char buf[LONG_STRING];
+  int ret;
+
+  strfcpy (buf, query, sizeof (buf));
+  ret = pop_query (pop_data, buf, sizeof (buf));
+  if (ret < 0)
+    return ret;
+
+  return pop_read_data (pop_data, progressbar, funct, data);
+}
+
+/* table of the headers in ctx by UIDL, for matching the server's UIDL list */
+HASH *pop_uidl_hash (CONTEXT *ctx)
+{
+  HASH *uidls;
+  int i;
+
+  uidls = hash_create (ctx->msgcount > 0 ? 2 * ctx->msgcount : 64, 0);
+  for (i = 0; i < ctx->msgcount; i++)
+    if (ctx->hdrs[i]->data)
+      hash_insert (uidls, ctx->hdrs[i]->data, ctx->hdrs[i], 0);
+
+  return uidls;
+}
+
 /* find message with this UIDL and set refno */
 static int check_uidl (char *line, void *data)
 {
-  int i;
   unsigned int index;
-  CONTEXT *ctx = (CONTEXT *)data;
+  HASH *uidls = (HASH *)data;
+  HEADER *h;
   char *endp;
 
   errno = 0;
@@ -535,14 +663,8 @@ static int check_uidl (char *line, void *data)
       endp++;
   memmove(line, endp, strlen(endp) + 1);
 
-  for (i = 0; i < ctx->msgcount; i++)
-  {
-    if (!mutt_strcmp (ctx->hdrs[i]->data, line))
-    {
-      ctx->hdrs[i]->refno = index;
-      break;
-    }
-  }
+  if ((h = hash_find (uidls, line)))
+    h->refno = index;
 
   return 0;
 }
@@ -566,6 +688,7 @@ int pop_reconnect (CONTEXT *ctx)
     ret = pop_open_connection (pop_data);
     if (ret == 0)
     {
+      HASH *uidls;
       int i;
 
       mutt_progress_init (&progressbar, _("Verifying message indexes..."),
@@ -574,7 +697,9 @@ int pop_reconnect (CONTEXT *ctx)
       for (i = 0; i < ctx->msgcount; i++)
 	ctx->hdrs[i]->refno = -1;
 
-      ret = pop_fetch_data (pop_data, "UIDL\r\n", &progressbar, check_uidl, ctx);
+      uidls = pop_uidl_hash (ctx);
+      ret = pop_fetch_data (pop_data, "UIDL\r\n", &progressbar, check_uidl, uidls);
+      hash_destroy (&uidls, NULL);
       if (ret == -2)
       {
         mutt_error ("%s", pop_data->err_msg);
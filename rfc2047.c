@@ -62,7 +62,7 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
   size_t obl, n;
   int e;
 
-  cd = mutt_iconv_open (to, from, 0);
+  cd = mutt_iconv_get (to, from, 0);
   if (cd == (iconv_t)(-1))
     return (size_t)(-1);
   obl = 4 * flen + 1;
@@ -72,7 +72,6 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
   {
     e = errno;
     FREE (&buf);
-    iconv_close (cd);
     errno = e;
     return (size_t)(-1);
   }
@@ -82,7 +81,6 @@ static size_t convert_string (ICONV_CONST char *f, size_t flen,
 
   safe_realloc (&buf, ob - buf + 1);
   *t = buf;
-  iconv_close (cd);
 
   return n;
 }
@@ -280,18 +278,16 @@ static size_t try_block (ICONV_CONST char *d, size_t dlen,
 
   if (fromcode)
   {
-    cd = mutt_iconv_open (tocode, fromcode, 0);
+    cd = mutt_iconv_get (tocode, fromcode, 0);
     assert (cd != (iconv_t)(-1));
     ib = d, ibl = dlen, ob = buf1, obl = sizeof (buf1) - strlen (tocode);
     if (iconv (cd, &ib, &ibl, &ob, &obl) == (size_t)(-1) ||
 	iconv (cd, 0, 0, &ob, &obl) == (size_t)(-1))
     {
       assert (errno == E2BIG);
-      iconv_close (cd);
       assert (ib > d);
       return (ib - d == dlen) ? dlen : ib - d + 1;
     }
-    iconv_close (cd);
   }
   else
   {
@@ -351,13 +347,12 @@ static size_t encode_block (char *s, char *d, size_t dlen,
 
   if (fromcode)
   {
-    cd = mutt_iconv_open (tocode, fromcode, 0);
+    cd = mutt_iconv_get (tocode, fromcode, 0);
     assert (cd != (iconv_t)(-1));
     ib = d, ibl = dlen, ob = buf1, obl = sizeof (buf1) - strlen (tocode);
     n1 = iconv (cd, &ib, &ibl, &ob, &obl);
     n2 = iconv (cd, 0, 0, &ob, &obl);
     assert (n1 != (size_t)(-1) && n2 != (size_t)(-1));
-    iconv_close (cd);
     return (*encoder) (s, buf1, ob - buf1, tocode);
   }
   else
@@ -814,6 +809,18 @@ void rfc2047_decode (char **pd)
   if (!s || !*s)
     return;
 
+  /* Most header fields contain no encoded words at all.  Unless
+   * $assumed_charset might apply to them, they are left as they are. */
+  if (!strstr (s, "=?"))
+  {
+    if (!AssumedCharset || !*AssumedCharset)
+      return;
+    for (p = s; *p == '\t' || (0x20 <= *p && *p < 0x7f); p++)
+      ;
+    if (!*p)
+      return;
+  }
+
   dlen = 4 * strlen (s); /* should be enough */
   d = d0 = safe_malloc (dlen + 1);
 
@@ -79,9 +79,20 @@ static void encode_quoted (FGETCONV * fc, FILE *fout, int istext)
 {
   int c, linelen = 0;
   char line[77], savechar;
+  char buf[BUFSIZ], *p = buf, *end = buf;
+  size_t n;
 
-  while ((c = fgetconv (fc)) != EOF)
+  for (;;)
   {
+    if (p == end)
+    {
+      if ((n = fgetconv_read (buf, sizeof (buf), fc)) == 0)
+	break;
+      p = buf;
+      end = buf + n;
+    }
+    c = (unsigned char) *p++;
+
     /* Wrap the line if needed. */
     if (linelen == 76 && ((istext && c != '\n') || !istext))
     {
@@ -207,76 +218,49 @@ static void encode_quoted (FGETCONV * fc, FILE *fout, int istext)
   }
 }
 
-static char b64_buffer[3];
-static short b64_num;
-static short b64_linelen;
+/* 54 input bytes make up one 72 character line of base64 */
+#define B64_LINE 54
 
-static void b64_flush(FILE *fout)
+static void encode_base64 (FGETCONV * fc, FILE *fout, int istext)
 {
-  short i;
+  char raw[B64_LINE * 32];
+  unsigned char in[2 * sizeof (raw) + B64_LINE];
+  char out[(B64_LINE / 3 * 4 + 1) * 2 * 33 + 1];
+  size_t n, i, inl = 0, off, ol;
+  int ch1 = EOF, lines = 0;
 
-  if(!b64_num)
-    return;
-
-  if(b64_linelen >= 72)
+  for (;;)
   {
-    fputc('\n', fout);
-    b64_linelen = 0;
-  }
+    n = fgetconv_read (raw, sizeof (raw), fc);
 
-  for(i = b64_num; i < 3; i++)
-    b64_buffer[i] = '\0';
-
-  fputc(B64Chars[(b64_buffer[0] >> 2) & 0x3f], fout);
-  b64_linelen++;
-  fputc(B64Chars[((b64_buffer[0] & 0x3) << 4) | ((b64_buffer[1] >> 4) & 0xf) ], fout);
-  b64_linelen++;
+    for (i = 0; i < n; i++)
+    {
+      if (istext && raw[i] == '\n' && ch1 != '\r')
+	in[inl++] = '\r';
+      in[inl++] = raw[i];
+      ch1 = raw[i];
+    }
 
-  if(b64_num > 1)
-  {
-    fputc(B64Chars[((b64_buffer[1] & 0xf) << 2) | ((b64_buffer[2] >> 6) & 0x3) ], fout);
-    b64_linelen++;
-    if(b64_num > 2)
+    /* encode all complete lines, and whatever is left at the end */
+    for (off = ol = 0; inl - off >= B64_LINE || (!n && off < inl); lines++)
     {
-      fputc(B64Chars[b64_buffer[2] & 0x3f], fout);
-      b64_linelen++;
+      i = MIN (inl - off, B64_LINE);
+      mutt_to_base64 ((unsigned char *) out + ol, in + off, i,
+		      sizeof (out) - ol);
+      ol += strlen (out + ol);
+      out[ol++] = '\n';
+      off += i;
     }
-  }
+    fwrite (out, 1, ol, fout);
+    memmove (in, in + off, inl - off);
+    inl -= off;
 
-  while(b64_linelen % 4)
-  {
-    fputc('=', fout);
-    b64_linelen++;
+    if (!n)
+      break;
   }
 
-  b64_num = 0;
-}
-
-
-static void b64_putc(char c, FILE *fout)
-{
-  if(b64_num == 3)
-    b64_flush(fout);
-
-  b64_buffer[b64_num++] = c;
-}
-
-
-static void encode_base64 (FGETCONV * fc, FILE *fout, int istext)
-{
-  int ch, ch1 = EOF;
-
-  b64_num = b64_linelen = 0;
-
-  while ((ch = fgetconv (fc)) != EOF)
-  {
-    if (istext && ch == '\n' && ch1 != '\r')
-      b64_putc('\r', fout);
-    b64_putc(ch, fout);
-    ch1 = ch;
-  }
-  b64_flush(fout);
-  fputc('\n', fout);
+  if (!lines)
+    fputc('\n', fout);
 }
 
 static void encode_8bit (FGETCONV *fc, FILE *fout, int istext)
@@ -520,6 +504,16 @@ static void update_content_info (CONTENT *info, CONTENT_STATE *s, char *d, size_
   {
     char ch = *d;
 
+    /* plain text past the start of a line can't affect anything but
+     * the counters */
+    if (linelen >= 4 && !was_cr && ch > 32 && ch < 127)
+    {
+      linelen++;
+      info->ascii++;
+      whitespace = 0;
+      continue;
+    }
+
     if (was_cr)
     {
       was_cr = 0;
@@ -851,7 +845,7 @@ CONTENT *mutt_get_content_info (const char *fname, BODY *b)
   FILE *fp = NULL;
   char *fromcode = NULL;
   char *tocode;
-  char buffer[100];
+  char buffer[BUFSIZ];
   char chsbuf[STRING];
   size_t r;
 
@@ -35,6 +35,10 @@ static short  OldWidth;		/* sidebar_width */
 static short  PreviousSort;	/* sidebar_sort_method */
 static time_t LastRefresh;	/* Time of last refresh */
 
+/* Settings the cached sidebar entries were formatted with */
+static char        *EntrySettings;
+static unsigned int EntryGeneration;
+
 /* Keep track of various BUFFYs */
 static BUFFY *TopBuffy;		/* First mailbox visible in sidebar */
 static BUFFY *OpnBuffy;		/* Current (open) mailbox */
@@ -324,6 +328,75 @@ make_sidebar_entry (char *buf, unsigned int buflen, int width, char *box,
 	}
 }
 
+/**
+ * check_entry_settings - Invalidate the cached entries if the config changed
+ *
+ * The formatted entries depend on "sidebar_format", "sidebar_short_path",
+ * "sidebar_folder_indent", "sidebar_indent_string", "sidebar_delim_chars"
+ * and "folder".  If any of them has changed since the last call, start a new
+ * generation, so that every entry is formatted again.
+ */
+static void
+check_entry_settings (void)
+{
+	char buf[LONG_STRING];
+
+	snprintf (buf, sizeof (buf), "%s\n%s\n%s\n%s\n%d%d",
+		NONULL(SidebarFormat), NONULL(SidebarIndentString),
+		NONULL(SidebarDelimChars), NONULL(Maildir),
+		option (OPTSIDEBARSHORTPATH) ? 1 : 0,
+		option (OPTSIDEBARFOLDERINDENT) ? 1 : 0);
+
+	if (mutt_strcmp (buf, EntrySettings) != 0) {
+		mutt_str_replace (&EntrySettings, buf);
+		EntryGeneration++;
+	}
+}
+
+/**
+ * entry_is_cached - Is the BUFFY's last formatted entry still valid
+ * @b:          BUFFY to check
+ * @width:      Desired width in screen cells
+ * @is_context: BUFFY is the open mailbox
+ *
+ * The entry of the open mailbox is never reused: it shows the Context's
+ * numbers, e.g. '%d' and '%t'.
+ *
+ * Returns:
+ *	Boolean
+ */
+static int
+entry_is_cached (BUFFY *b, int width, int is_context)
+{
+	struct buffy_sbentry *e = &b->sb_entry;
+
+	return e->str && !is_context &&
+		(e->generation  == EntryGeneration) &&
+		(e->width       == width) &&
+		(e->msg_count   == b->msg_count) &&
+		(e->msg_unread  == b->msg_unread) &&
+		(e->msg_flagged == b->msg_flagged);
+}
+
+/**
+ * cache_entry - Remember a BUFFY's formatted entry
+ * @b:     BUFFY the entry belongs to
+ * @str:   Formatted entry
+ * @width: Width in screen cells it was formatted for
+ */
+static void
+cache_entry (BUFFY *b, const char *str, int width)
+{
+	struct buffy_sbentry *e = &b->sb_entry;
+
+	mutt_str_replace (&e->str, str);
+	e->generation  = EntryGeneration;
+	e->width       = width;
+	e->msg_count   = b->msg_count;
+	e->msg_unread  = b->msg_unread;
+	e->msg_flagged = b->msg_flagged;
+}
+
 /**
  * cb_qsort_buffy - qsort callback to sort BUFFYs
  * @a: First  BUFFY to compare
@@ -476,15 +549,21 @@ sort_buffy_array (BUFFY **arr, int arr_len)
 
 	/* These are the only sort methods we understand */
 	short ssm = (SidebarSortMethod & SORT_MASK);
+	int i;
 	if ((ssm == SORT_COUNT)     ||
 	    (ssm == SORT_COUNT_NEW) ||
 	    (ssm == SORT_DESC)      ||
 	    (ssm == SORT_FLAGGED)   ||
 	    (ssm == SORT_PATH)) {
-		qsort (arr, arr_len, sizeof (*arr), cb_qsort_buffy);
+		/* The list is mostly still in order from the last time */
+		for (i = 1; i < arr_len; i++) {
+			if (cb_qsort_buffy (&arr[i - 1], &arr[i]) > 0)
+				break;
+		}
+		if (i < arr_len)
+			qsort (arr, arr_len, sizeof (*arr), cb_qsort_buffy);
 	}
 
-	int i;
 	for (i = 0; i < (arr_len - 1); i++) {
 		arr[i]->next = arr[i + 1];
 	}
@@ -717,6 +796,9 @@ draw_sidebar (int first_row, int num_rows, int div_width)
 
 	int w = MIN(COLS, (SidebarWidth - div_width));
 	int row = 0;
+
+	check_entry_settings();
+
 	for (b = TopBuffy; b && (row < num_rows); b = b->next) {
 		if (b->is_hidden) {
 			continue;
@@ -742,12 +824,20 @@ draw_sidebar (int first_row, int num_rows, int div_width)
 		}
 
 		move (first_row + row, 0);
+		int is_context = 0;
 		if (Context && Context->path &&
 			(!strcmp (b->path, Context->path)||
 			 !strcmp (b->realpath, Context->path))) {
 			b->msg_unread  = Context->unread;
 			b->msg_count   = Context->msgcount;
 			b->msg_flagged = Context->flagged;
+			is_context = 1;
+		}
+
+		if (entry_is_cached (b, w, is_context)) {
+			printw ("%s", b->sb_entry.str);
+			row++;
+			continue;
 		}
 
 		/* compute length of Maildir without trailing separator */
@@ -807,6 +897,7 @@ draw_sidebar (int first_row, int num_rows, int div_width)
 #endif
 		char str[SHORT_STRING];
 		make_sidebar_entry (str, sizeof (str), w, sidebar_folder_name, b);
+		cache_entry (b, str, w);
 		printw ("%s", str);
 		if (sidebar_folder_depth > 0)
 			free (sidebar_folder_name);
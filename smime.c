@@ -1826,6 +1826,8 @@ static BODY *smime_handle_entity (BODY *m, STATE *s, FILE *outFile)
   struct stat info;
   BODY *p=NULL;
   pid_t thepid=-1;
+  unsigned char digest[16];
+  int rc;
   unsigned int type = mutt_is_application_smime (m);
 
   if (!(type & APPLICATION_SMIME)) return NULL;
@@ -1846,6 +1848,10 @@ static BODY *smime_handle_entity (BODY *m, STATE *s, FILE *outFile)
   }
   mutt_unlink (errfile);
 
+  if ((type & ENCRYPT) &&
+      crypt_decrypted_lookup (s->fpin, m->offset, m->length, 1, digest,
+			      smimeout, smimeerr, &rc) == 0)
+    goto decrypted;
   
   mutt_mktemp (tmpfname, sizeof (tmpfname));
   if ((tmpfp = safe_fopen (tmpfname, "w+")) == NULL)
@@ -1896,9 +1902,13 @@ static BODY *smime_handle_entity (BODY *m, STATE *s, FILE *outFile)
 
   safe_fclose (&smimein);
 	
-  mutt_wait_filter (thepid);
+  rc = mutt_wait_filter (thepid);
   mutt_unlink (tmpfname);
-  
+
+  if ((type & ENCRYPT) && rc == 0)
+    crypt_decrypted_store (digest, 1, smimeout, 0, smimeerr, rc);
+
+decrypted:
 
   if (s->flags & M_DISPLAY)
   {
@@ -56,12 +56,17 @@
 #define SMTP_AUTH_UNAVAIL 1
 #define SMTP_AUTH_FAIL    -1
 
+/* size of the blocks the message is sent in */
+#define SMTP_CHUNK_SIZE 65536
+
 enum {
   STARTTLS,
   AUTH,
   DSN,
   EIGHTBITMIME,
   SMTPUTF8,
+  PIPELINING,
+  CHUNKING,
 
   CAPMAX
 };
@@ -78,6 +83,9 @@ static int Esmtp = 0;
 static char* AuthMechs = NULL;
 static unsigned char Capabilities[(CAPMAX + 7)/ 8];
 
+/* connection kept open for the next message, see $smtp_reuse_connection */
+static CONNECTION* SmtpConn = NULL;
+
 static int smtp_code (char *buf, size_t len, int *n)
 {
   char code[4];
@@ -125,6 +133,10 @@ smtp_get_resp (CONNECTION * conn)
       mutt_bit_set (Capabilities, STARTTLS);
     else if (!ascii_strncasecmp ("SMTPUTF8", buf + 4, 8))
       mutt_bit_set (Capabilities, SMTPUTF8);
+    else if (!ascii_strncasecmp ("PIPELINING", buf + 4, 10))
+      mutt_bit_set (Capabilities, PIPELINING);
+    else if (!ascii_strncasecmp ("CHUNKING", buf + 4, 8))
+      mutt_bit_set (Capabilities, CHUNKING);
 
     if (smtp_code (buf, n, &n) < 0)
       return smtp_err_code;
@@ -138,8 +150,10 @@ smtp_get_resp (CONNECTION * conn)
     return -1;
 }
 
+/* With PIPELINING, the commands are only added to cmds, and pending
+ * counts the responses to be read after sending them. */
 static int
-smtp_rcpt_to (CONNECTION * conn, const ADDRESS * a)
+smtp_rcpt_to (CONNECTION * conn, const ADDRESS * a, BUFFER *cmds, int *pending)
 {
   char buf[1024];
   int r;
@@ -157,89 +171,204 @@ smtp_rcpt_to (CONNECTION * conn, const ADDRESS * a)
                 a->mailbox, DsnNotify);
     else
       snprintf (buf, sizeof (buf), "RCPT TO:<%s>\r\n", a->mailbox);
-    if (mutt_socket_write (conn, buf) == -1)
-      return smtp_err_write;
-    if ((r = smtp_get_resp (conn)))
-      return r;
+    if (cmds)
+    {
+      mutt_buffer_addstr (cmds, buf);
+      (*pending)++;
+    }
+    else
+    {
+      if (mutt_socket_write (conn, buf) == -1)
+        return smtp_err_write;
+      if ((r = smtp_get_resp (conn)))
+        return r;
+    }
     a = a->next;
   }
 
   return 0;
 }
 
-static int
-smtp_data (CONNECTION * conn, const char *msgfile)
+/* Copies the next block of the message in fp to buf, converted to CRLF
+ * line endings and dot-stuffed if stuff is set; bol tracks whether we are
+ * at the beginning of a line.  Returns the length of the block, 0 at the
+ * end of the message.
+ */
+static size_t
+smtp_fill (FILE *fp, char *buf, size_t buflen, int stuff, int *bol)
 {
-  char buf[1024];
-  FILE *fp = 0;
-  progress_t progress;
-  struct stat st;
-  int r, term = 0;
-  size_t buflen = 0;
+  char line[1024];
+  size_t len = 0, n;
+  int term;
 
-  fp = fopen (msgfile, "r");
-  if (!fp)
+  /* a line grows by at most a dot and the CR */
+  while (len + sizeof (line) + 2 <= buflen && fgets (line, sizeof (line) - 1, fp))
   {
-    mutt_error (_("SMTP session failed: unable to open %s"), msgfile);
-    return -1;
+    n = mutt_strlen (line);
+    if (stuff && *bol && line[0] == '.')
+      buf[len++] = '.';
+    term = n && line[n - 1] == '\n';
+    if (term && --n && line[n - 1] == '\r')
+      n--;
+    memcpy (buf + len, line, n);
+    len += n;
+    if (term)
+    {
+      buf[len++] = '\r';
+      buf[len++] = '\n';
+    }
+    *bol = term;
   }
-  stat (msgfile, &st);
-  unlink (msgfile);
-  mutt_progress_init (&progress, _("Sending message..."), M_PROGRESS_SIZE,
-                      NetInc, st.st_size);
 
-  snprintf (buf, sizeof (buf), "DATA\r\n");
-  if (mutt_socket_write (conn, buf) == -1)
-  {
-    safe_fclose (&fp);
+  return len;
+}
+
+/* Sends the message with DATA, in large blocks rather than line by line */
+static int
+smtp_data (CONNECTION * conn, FILE *fp, progress_t *progress)
+{
+  char *buf;
+  size_t len;
+  int r, bol = 1;
+
+  if (mutt_socket_write (conn, "DATA\r\n") == -1)
     return smtp_err_write;
-  }
   if ((r = smtp_get_resp (conn)))
-  {
-    safe_fclose (&fp);
     return r;
+
+  /* terminated for the debug log */
+  buf = safe_malloc (SMTP_CHUNK_SIZE + 1);
+  while ((len = smtp_fill (fp, buf, SMTP_CHUNK_SIZE, 1, &bol)))
+  {
+    buf[len] = '\0';
+    if (mutt_socket_write_d (conn, buf, len, M_SOCK_LOG_FULL) == -1)
+    {
+      FREE (&buf);
+      return smtp_err_write;
+    }
+    mutt_progress_update (progress, ftell (fp), -1);
   }
+  FREE (&buf);
+
+  /* terminate the message body */
+  if (mutt_socket_write (conn, bol ? ".\r\n" : "\r\n.\r\n") == -1)
+    return smtp_err_write;
 
-  while (fgets (buf, sizeof (buf) - 1, fp))
+  return smtp_get_resp (conn);
+}
+
+/* Sends the message in BDAT chunks (RFC 3030), which need no dot-stuffing
+ * and no 354 round trip.  With PIPELINING the chunks are sent back to back
+ * and the responses read at the end.
+ */
+static int
+smtp_bdat (CONNECTION * conn, FILE *fp, progress_t *progress)
+{
+  char *buf, *chunk;
+  char cmd[STRING];
+  size_t len, cmdlen;
+  int c, r = 0, bol = 1, last = 0, pending = 0;
+  int pipeline = mutt_bit_isset (Capabilities, PIPELINING);
+
+  /* leave room for the command in front of the data, and for a final
+   * CRLF and the terminator for the debug log after it */
+  buf = safe_malloc (sizeof (cmd) + SMTP_CHUNK_SIZE + 3);
+  chunk = buf + sizeof (cmd);
+
+  while (!last)
   {
-    buflen = mutt_strlen (buf);
-    term = buflen && buf[buflen-1] == '\n';
-    if (term && (buflen == 1 || buf[buflen - 2] != '\r'))
-      snprintf (buf + buflen - 1, sizeof (buf) - buflen + 1, "\r\n");
-    if (buf[0] == '.')
+    len = smtp_fill (fp, chunk, SMTP_CHUNK_SIZE, 0, &bol);
+    if ((c = getc (fp)) == EOF)
     {
-      if (mutt_socket_write_d (conn, ".", -1, M_SOCK_LOG_FULL) == -1)
+      last = 1;
+      if (!bol)
       {
-        safe_fclose (&fp);
-        return smtp_err_write;
+        chunk[len++] = '\r';
+        chunk[len++] = '\n';
       }
     }
-    if (mutt_socket_write_d (conn, buf, -1, M_SOCK_LOG_FULL) == -1)
+    else
+      ungetc (c, fp);
+    chunk[len] = '\0';
+
+    cmdlen = snprintf (cmd, sizeof (cmd), "BDAT %ld%s\r\n", (long) len,
+                       last ? " LAST" : "");
+    memcpy (chunk - cmdlen, cmd, cmdlen);
+    if (mutt_socket_write_d (conn, chunk - cmdlen, cmdlen + len, M_SOCK_LOG_FULL) == -1)
     {
-      safe_fclose (&fp);
-      return smtp_err_write;
+      r = smtp_err_write;
+      break;
+    }
+    mutt_progress_update (progress, ftell (fp), -1);
+
+    if (!pipeline)
+    {
+      if ((r = smtp_get_resp (conn)))
+        break;
     }
-    mutt_progress_update (&progress, ftell (fp), -1);
+    else
+      pending++;
   }
-  if (!term && buflen &&
-      mutt_socket_write_d (conn, "\r\n", -1, M_SOCK_LOG_FULL) == -1)
+  FREE (&buf);
+
+  while (r != smtp_err_write && pending--)
+    if ((c = smtp_get_resp (conn)) && !r)
+      r = c;
+
+  return r;
+}
+
+static int
+smtp_send_message (CONNECTION * conn, const char *msgfile)
+{
+  FILE *fp;
+  progress_t progress;
+  struct stat st;
+  int r;
+
+  fp = fopen (msgfile, "r");
+  if (!fp)
   {
-    safe_fclose (&fp);
-    return smtp_err_write;
+    mutt_error (_("SMTP session failed: unable to open %s"), msgfile);
+    return -1;
   }
+  stat (msgfile, &st);
+  unlink (msgfile);
+  mutt_progress_init (&progress, _("Sending message..."), M_PROGRESS_SIZE,
+                      NetInc, st.st_size);
+
+  if (mutt_bit_isset (Capabilities, CHUNKING))
+    r = smtp_bdat (conn, fp, &progress);
+  else
+    r = smtp_data (conn, fp, &progress);
+
   safe_fclose (&fp);
+  return r;
+}
 
-  /* terminate the message body */
-  if (mutt_socket_write (conn, ".\r\n") == -1)
-    return smtp_err_write;
+/* Checks whether the connection kept from the last message can be used
+ * again, i.e. whether the server is still there and has reset its state.
+ */
+static int
+smtp_reuse (CONNECTION * conn)
+{
+  char buf[1024];
+  int n;
 
-  if ((r = smtp_get_resp (conn)))
-    return r;
+  /* the server isn't supposed to say anything now, except that it's
+   * closing the connection */
+  if (mutt_socket_poll (conn) > 0)
+    return -1;
+
+  if (mutt_socket_write (conn, "RSET\r\n") == -1)
+    return -1;
+  if ((n = mutt_socket_readln (buf, sizeof (buf), conn)) < 4
+      || smtp_code (buf, n, &n) < 0 || !smtp_success (n))
+    return -1;
 
   return 0;
 }
 
-
 /* Returns 1 if a contains at least one 8-bit character, 0 if none do.
  */
 static int address_uses_unicode(const char *a)
@@ -281,7 +410,8 @@ mutt_smtp_send (const ADDRESS* from, const ADDRESS* to, const ADDRESS* cc,
   ACCOUNT account;
   const char* envfrom;
   char buf[1024];
-  int ret = -1;
+  BUFFER *cmds = NULL;
+  int ret = -1, pending = 0;
 
   /* it might be better to synthesize an envelope from from user and host
    * but this condition is most likely arrived at accidentally */
@@ -301,14 +431,34 @@ mutt_smtp_send (const ADDRESS* from, const ADDRESS* to, const ADDRESS* cc,
   if (!(conn = mutt_conn_find (NULL, &account)))
     return -1;
 
-  Esmtp = eightbit;
+  /* only one connection is kept, and only for the current $smtp_url */
+  if (SmtpConn && SmtpConn != conn)
+    mutt_smtp_close ();
 
   do
   {
-    /* send our greeting */
-    if (( ret = smtp_open (conn)))
-      break;
-    FREE (&AuthMechs);
+    /* reuse the connection of the last message if we may; the server has
+     * to speak ESMTP again if it has to for this message */
+    if (!option (OPTSMTPREUSE) || conn != SmtpConn || conn->fd < 0
+        || (eightbit && !Esmtp) || smtp_reuse (conn) < 0)
+    {
+      SmtpConn = NULL;
+      if (conn->fd >= 0)
+        mutt_socket_close (conn);
+
+      Esmtp = eightbit;
+
+      /* send our greeting */
+      if (( ret = smtp_open (conn)))
+        break;
+      FREE (&AuthMechs);
+    }
+
+    /* with PIPELINING, the envelope goes out in one write */
+    if (mutt_bit_isset (Capabilities, PIPELINING))
+    {
+      cmds = mutt_buffer_new ();
+    }
 
     /* send the sender's address */
     ret = snprintf (buf, sizeof (buf), "MAIL FROM:<%s>", envfrom);
@@ -326,31 +476,64 @@ mutt_smtp_send (const ADDRESS* from, const ADDRESS* to, const ADDRESS* cc,
 	 addresses_use_unicode(bcc)))
       ret += snprintf (buf + ret, sizeof (buf) - ret, " SMTPUTF8");
     safe_strncat (buf, sizeof (buf), "\r\n", 3);
-    if (mutt_socket_write (conn, buf) == -1)
+    if (cmds)
     {
-      ret = smtp_err_write;
-      break;
+      mutt_buffer_addstr (cmds, buf);
+      pending++;
+    }
+    else
+    {
+      if (mutt_socket_write (conn, buf) == -1)
+      {
+        ret = smtp_err_write;
+        break;
+      }
+      if ((ret = smtp_get_resp (conn)))
+        break;
     }
-    if ((ret = smtp_get_resp (conn)))
-      break;
 
     /* send the recipient list */
-    if ((ret = smtp_rcpt_to (conn, to)) || (ret = smtp_rcpt_to (conn, cc))
-        || (ret = smtp_rcpt_to (conn, bcc)))
+    if ((ret = smtp_rcpt_to (conn, to, cmds, &pending))
+        || (ret = smtp_rcpt_to (conn, cc, cmds, &pending))
+        || (ret = smtp_rcpt_to (conn, bcc, cmds, &pending)))
       break;
 
+    if (cmds)
+    {
+      if (mutt_socket_write (conn, cmds->data) == -1)
+      {
+        ret = smtp_err_write;
+        break;
+      }
+      /* any failure aborts the message, as without PIPELINING */
+      while (pending-- && !(ret = smtp_get_resp (conn)))
+        ;
+      if (ret)
+        break;
+    }
+
     /* send the message data */
-    if ((ret = smtp_data (conn, msgfile)))
+    if ((ret = smtp_send_message (conn, msgfile)))
       break;
 
-    mutt_socket_write (conn, "QUIT\r\n");
+    if (option (OPTSMTPREUSE))
+      SmtpConn = conn;
+    else
+      mutt_socket_write (conn, "QUIT\r\n");
 
     ret = 0;
   }
   while (0);
 
-  if (conn)
-    mutt_socket_close (conn);
+  mutt_buffer_free (&cmds);
+
+  if (conn != SmtpConn || ret)
+  {
+    if (conn == SmtpConn)
+      SmtpConn = NULL;
+    if (conn->fd >= 0)
+      mutt_socket_close (conn);
+  }
 
   if (ret == smtp_err_read)
     mutt_error (_("SMTP session failed: read error"));
@@ -362,6 +545,20 @@ mutt_smtp_send (const ADDRESS* from, const ADDRESS* to, const ADDRESS* cc,
   return ret;
 }
 
+/* Says goodbye on the connection kept by $smtp_reuse_connection */
+void mutt_smtp_close (void)
+{
+  if (!SmtpConn)
+    return;
+
+  if (SmtpConn->fd >= 0)
+  {
+    mutt_socket_write (SmtpConn, "QUIT\r\n");
+    mutt_socket_close (SmtpConn);
+  }
+  SmtpConn = NULL;
+}
+
 static int smtp_fill_account (ACCOUNT* account)
 {
   static unsigned short SmtpPort = 0;
@@ -246,6 +246,7 @@ void mutt_sort_headers (CONTEXT *ctx, int init)
   sort_t *sortfunc;
   
   unset_option (OPTNEEDRESORT);
+  IndexLineGen++;
 
   if (!ctx)
     return;
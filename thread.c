@@ -239,6 +239,8 @@ void mutt_draw_tree (CONTEXT *ctx)
   int depth = 0, start_depth = 0, max_depth = 0, width = option (OPTNARROWTREE) ? 1 : 2;
   THREAD *nextdisp = NULL, *pseudo = NULL, *parent = NULL, *tree = ctx->tree;
 
+  IndexLineGen++;
+
   /* Do the visibility calculations and free the old thread chars.
    * From now on we can simply ignore invisible subtrees
    */
@@ -1167,7 +1169,7 @@ int _mutt_traverse_thread (CONTEXT *ctx, HEADER *cur, int flag)
 
   if (flag & (M_THREAD_COLLAPSE | M_THREAD_UNCOLLAPSE))
   {
-    cur->pair = 0; /* force index entry's color to be re-evaluated */
+    cur->color_valid = 0; /* force index entry's color to be re-evaluated */
     cur->collapsed = flag & M_THREAD_COLLAPSE;
     if (cur->virtual != -1)
     {
@@ -1198,7 +1200,7 @@ int _mutt_traverse_thread (CONTEXT *ctx, HEADER *cur, int flag)
     {
       if (flag & (M_THREAD_COLLAPSE | M_THREAD_UNCOLLAPSE))
       {
-	cur->pair = 0; /* force index entry's color to be re-evaluated */
+	cur->color_valid = 0; /* force index entry's color to be re-evaluated */
 	cur->collapsed = flag & M_THREAD_COLLAPSE;
 	if (!roothdr && CHECK_LIMIT)
 	{